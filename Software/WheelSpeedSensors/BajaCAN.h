@@ -1,6 +1,6 @@
 /*********************************************************************************
 *
-*   BajaCAN.h  -- Version 2.2.1 - Native ESP32 CAN Driver
+*   BajaCAN.h  -- Version 2.3.0 - Native ESP32 CAN Driver
 *
 *   The goal of this BajaCAN header/driver is to enable all subsystems throughout
 *   the vehicle to use the same variables, data types, and functions. That way,
@@ -76,6 +76,17 @@
 *     data can just be sent on a fixed interval without any intervention by the main code.
 *
 *
+*     *** Version 2.3.0 ***
+*
+*     Adds the wheel speed board's packed wheel slip and wheel state frames (the
+*     state frame also carries sprag clutch engagement), the packed wheel yaw rate
+*     frame, sprag transition events and its diagnostics, shock histogram and shock
+*     calibration request/reply IDs. A board still running 2.2.1 prints a line for
+*     every frame with an ID it doesn't know, which at 100 Hz stalls its CAN task on
+*     Serial, so every subsystem has to be moved to 2.3.0 together. From 2.3.0 on
+*     each unknown ID is only printed once.
+*
+*
 *     *** Roadmap Ideas ***
 *       - Implement a flag that is set when a data value is updated, and reset when
 *         the main core reads that new data value. This could be practical in
@@ -87,6 +98,7 @@
 ************************************************************************************/
 
 #include "driver/can.h"
+#include <atomic>
 
 // CAN Configuration
 #define CAN_BAUD_RATE CAN_TIMING_CONFIG_500KBITS()
@@ -123,6 +135,7 @@ const int frontLeftWheelState_ID = 0x0F;
 const int frontRightWheelState_ID = 0x10;
 const int rearLeftWheelState_ID = 0x11;
 const int rearRightWheelState_ID = 0x12;
+const int wheelYawRate_ID = 0x13;  // wheelYawRate and yawRateDiscrepancy in one frame, see sendWheelYawCAN()
 const int gasPedalPercentage_ID = 0x15;
 const int brakePedalPercentage_ID = 0x16;
 const int frontBrakePressure_ID = 0x17;
@@ -131,6 +144,9 @@ const int frontLeftDisplacement_ID = 0x1F;
 const int frontRightDisplacement_ID = 0x20;
 const int rearLeftDisplacement_ID = 0x21;
 const int rearRightDisplacement_ID = 0x22;
+const int wheelSlip_ID = 0x23;    // All four slips in one frame, see sendWheelSlipsCAN()
+const int wheelStates_ID = 0x24;  // All four states in one frame, see sendWheelStatesCAN()
+const int spragTransition_ID = 0x28;
 const int accelerationX_ID = 0x29;
 const int accelerationY_ID = 0x2A;
 const int accelerationZ_ID = 0x2B;
@@ -151,6 +167,12 @@ const int gpsVelocity_ID = 0x39;
 const int batteryPercentage_ID = 0x3A;
 const int sdLoggingActive_ID = 0x42;
 const int dataScreenshotFlag_ID = 0x43;
+const int wheelDiagnosticsRequest_ID = 0x44;
+const int wheelDiagnostics_ID = 0x45;
+const int shockHistogramRequest_ID = 0x46;
+const int shockHistogram_ID = 0x47;
+const int shockCalibrationRequest_ID = 0x48;
+const int shockCalibration_ID = 0x49;
 
 // CAN Variables
 volatile int primaryRPM;
@@ -165,6 +187,8 @@ volatile int frontLeftWheelState;
 volatile int frontRightWheelState;
 volatile int rearLeftWheelState;
 volatile int rearRightWheelState;
+volatile float wheelYawRate;        // deg/s from the wheel speeds (NAN when no axle is usable)
+volatile float yawRateDiscrepancy;  // gyroscopeYaw minus wheelYawRate
 volatile int gasPedalPercentage;
 volatile int brakePedalPercentage;
 volatile int frontBrakePressure;
@@ -173,6 +197,11 @@ volatile float frontLeftDisplacement;
 volatile float frontRightDisplacement;
 volatile float rearLeftDisplacement;
 volatile float rearRightDisplacement;
+volatile float frontLeftWheelSlip;  // Signed slip ratio, + spinning / - skidding
+volatile float frontRightWheelSlip;
+volatile float rearLeftWheelSlip;
+volatile float rearRightWheelSlip;
+volatile int spragEngagement;  // Bitmask of wheels whose sprag clutch is engaged
 volatile float accelerationX;
 volatile float accelerationY;
 volatile float accelerationZ;
@@ -193,6 +222,10 @@ volatile int gpsVelocity;
 volatile int batteryPercentage;
 volatile int sdLoggingActive;
 volatile int dataScreenshotFlag;
+// Set by the CAN task with fetch_or() and taken by loop() with exchange(), so no request is lost in between
+std::atomic<int> wheelDiagnosticsRequest(0);  // Bitmask of wheels whose diagnostics were requested (cleared once sent)
+std::atomic<int> shockHistogramRequest(0);    // Bitmask of corners whose velocity histograms were requested (cleared once sent)
+volatile int shockCalibrationRequest;  // Nonzero asks the wheel speed board to recalibrate the shock rest positions
 
 
 float parseFloatFromBytes(uint8_t* data, int length) {
@@ -263,6 +296,96 @@ bool sendCANFloat(uint32_t id, float value) {
   return (result == ESP_OK);
 }
 
+// Sends one value of a multi-value record: byte 0 is the record index, byte 1 the field,
+// bytes 2-3 are reserved and bytes 4-7 hold the value in the same byte order as sendCANInt()
+bool sendCANIndexedInt(uint32_t id, uint8_t index, uint8_t field, int value) {
+  can_message_t tx_message;
+  tx_message.flags = CAN_MSG_FLAG_NONE;
+  tx_message.identifier = id;
+  tx_message.extd = 0;
+  tx_message.rtr = 0;
+  tx_message.ss = 0;
+  tx_message.self = 0;
+  tx_message.dlc_non_comp = 0;
+
+  int length;
+  tx_message.data[0] = index;
+  tx_message.data[1] = field;
+  tx_message.data[2] = 0;
+  tx_message.data[3] = 0;
+  intToBytes(value, tx_message.data + 4, length);
+  tx_message.data_length_code = 8;
+  return (can_transmit(&tx_message, pdMS_TO_TICKS(10)) == ESP_OK);
+}
+
+// Slip ratios travel as big-endian int16s in units of 1/WHEEL_SLIP_SCALE (+-3.27)
+const float WHEEL_SLIP_SCALE = 10000;
+
+void int16ToBytes(int16_t value, uint8_t* buffer) {
+  buffer[0] = (value >> 8) & 0xFF;
+  buffer[1] = value & 0xFF;
+}
+
+int16_t parseInt16FromBytes(uint8_t* data) {
+  return (int16_t)((data[0] << 8) | data[1]);
+}
+
+int16_t slipToInt16(float slip) {
+  float scaled = slip * WHEEL_SLIP_SCALE;
+  if (!(scaled == scaled)) return 0;  // NAN
+  if (scaled > 32767) return 32767;
+  if (scaled < -32767) return -32767;
+  return (int16_t)lroundf(scaled);
+}
+
+bool sendCANBytes(uint32_t id, const uint8_t* bytes, int length) {
+  can_message_t tx_message;
+  tx_message.flags = CAN_MSG_FLAG_NONE;
+  tx_message.identifier = id;
+  tx_message.extd = 0;
+  tx_message.rtr = 0;
+  tx_message.ss = 0;
+  tx_message.self = 0;
+  tx_message.dlc_non_comp = 0;
+
+  memcpy(tx_message.data, bytes, length);
+  tx_message.data_length_code = length;
+  return (can_transmit(&tx_message, pdMS_TO_TICKS(10)) == ESP_OK);
+}
+
+// Four int16 slips, front left, front right, rear left, rear right
+bool sendWheelSlipsCAN() {
+  uint8_t data[8];
+  int16ToBytes(slipToInt16(frontLeftWheelSlip), data);
+  int16ToBytes(slipToInt16(frontRightWheelSlip), data + 2);
+  int16ToBytes(slipToInt16(rearLeftWheelSlip), data + 4);
+  int16ToBytes(slipToInt16(rearRightWheelSlip), data + 6);
+  return sendCANBytes(wheelSlip_ID, data, 8);
+}
+
+// One byte per wheel state in the same order, then the spragEngagement bitmask
+bool sendWheelStatesCAN() {
+  uint8_t data[5];
+  data[0] = frontLeftWheelState;
+  data[1] = frontRightWheelState;
+  data[2] = rearLeftWheelState;
+  data[3] = rearRightWheelState;
+  data[4] = spragEngagement;
+  return sendCANBytes(wheelStates_ID, data, 5);
+}
+
+// Two floats, wheelYawRate then yawRateDiscrepancy, in the same byte order as sendCANFloat()
+bool sendWheelYawCAN() {
+  uint8_t data[8];
+  int length;
+  floatToBytes(wheelYawRate, data, length);
+  floatToBytes(yawRateDiscrepancy, data + 4, length);
+  return sendCANBytes(wheelYawRate_ID, data, 8);
+}
+
+// Standard IDs already reported as unknown, one bit per ID
+uint32_t unknownCANIds[2048 / 32];
+
 // CAN Task function
 void CAN_Task_Code(void *pvParameters) {
   Serial.print("CAN_Task running on core ");
@@ -315,6 +438,33 @@ void CAN_Task_Code(void *pvParameters) {
           case rearRightWheelState_ID:
             rearRightWheelState = parseIntFromBytes(data, dataLength);
             break;
+          case wheelSlip_ID:
+            if (dataLength == 8) {
+              frontLeftWheelSlip = parseInt16FromBytes(data) / WHEEL_SLIP_SCALE;
+              frontRightWheelSlip = parseInt16FromBytes(data + 2) / WHEEL_SLIP_SCALE;
+              rearLeftWheelSlip = parseInt16FromBytes(data + 4) / WHEEL_SLIP_SCALE;
+              rearRightWheelSlip = parseInt16FromBytes(data + 6) / WHEEL_SLIP_SCALE;
+            }
+            break;
+          case wheelStates_ID:
+            if (dataLength >= 4) {
+              frontLeftWheelState = data[0];
+              frontRightWheelState = data[1];
+              rearLeftWheelState = data[2];
+              rearRightWheelState = data[3];
+            }
+            if (dataLength >= 5) {
+              spragEngagement = data[4];
+            }
+            break;
+          case spragTransition_ID:
+            break;  // Events from the wheel speed board, only used by the data logger
+          case wheelYawRate_ID:
+            if (dataLength == 8) {
+              wheelYawRate = parseFloatFromBytes(data, 4);
+              yawRateDiscrepancy = parseFloatFromBytes(data + 4, 4);
+            }
+            break;
           case gasPedalPercentage_ID:
             gasPedalPercentage = parseIntFromBytes(data, dataLength);
             break;
@@ -399,11 +549,30 @@ void CAN_Task_Code(void *pvParameters) {
           case dataScreenshotFlag_ID:
             dataScreenshotFlag = parseIntFromBytes(data, dataLength);
             break;
+          case wheelDiagnosticsRequest_ID:
+            wheelDiagnosticsRequest.fetch_or(parseIntFromBytes(data, dataLength));
+            break;
+          case wheelDiagnostics_ID:
+            break;  // Replies from the wheel speed board, only used by whoever asked
+          case shockHistogramRequest_ID:
+            shockHistogramRequest.fetch_or(parseIntFromBytes(data, dataLength));
+            break;
+          case shockHistogram_ID:
+            break;  // Replies from the wheel speed board, only used by whoever asked
+          case shockCalibrationRequest_ID:
+            shockCalibrationRequest = parseIntFromBytes(data, dataLength);
+            break;
+          case shockCalibration_ID:
+            break;  // Replies from the wheel speed board, only used by whoever asked
           default:
-            Serial.print("Unknown CAN ID: 0x");
-            Serial.print(packetId, HEX);
-            Serial.print(" Size: ");
-            Serial.println(dataLength);
+            // Once per ID, so a newer board on the bus can't flood Serial and stall this task
+            if (!(unknownCANIds[packetId / 32] & (1UL << (packetId % 32)))) {
+              unknownCANIds[packetId / 32] |= 1UL << (packetId % 32);
+              Serial.print("Unknown CAN ID: 0x");
+              Serial.print(packetId, HEX);
+              Serial.print(" Size: ");
+              Serial.println(dataLength);
+            }
             break;
         }
       }
@@ -426,6 +595,9 @@ void CAN_Task_Code(void *pvParameters) {
           sendCANFloat(frontRightWheelSpeed_ID, frontRightWheelSpeed);
           sendCANFloat(rearLeftWheelSpeed_ID, rearLeftWheelSpeed);
           sendCANFloat(rearRightWheelSpeed_ID, rearRightWheelSpeed);
+          sendWheelStatesCAN();
+          sendWheelSlipsCAN();
+          sendWheelYawCAN();
           sendCANFloat(frontLeftDisplacement_ID, frontLeftDisplacement);
           sendCANFloat(frontRightDisplacement_ID, frontRightDisplacement);
           sendCANFloat(rearLeftDisplacement_ID, rearLeftDisplacement);
@@ -5,14 +5,44 @@
   changes as it moves a certain distance. Then, by using the motion ratio of the suspension
   system, we can determine the wheel displacement from the suspension suspension displacement 
 
+  The potentiometer itself is linear, but the ESP32 ADC is not: at the default 11 dB
+  attenuation it bends by tens of millivolts toward either end, which is exactly where full
+  bump and full droop sit. Each channel's reading is corrected with the chip's eFuse ADC
+  calibration and mapped through the measured motion ratio curve once, into a table of wheel
+  displacement at every SHOCK_TABLE_STEP counts; at run time a reading is one lookup and an
+  integer interpolation.
+
 */
 
+#include "esp_adc_cal.h"
+#include "ShockFilter.h"
+#include "ShockVelocity.h"
+
 // The motion ratio defines the ratio between shock travel and wheel travel
 // For every 0.75" that the front shock travels, the front wheel will travel 1"
 const float frontMotionRatio = 0.75;
 const float rearMotionRatio = 0.82;
 
-// Experimentally-found rest values of shocks
+// Measured motion ratio curves: wheel travel at each shock travel, both in inches from ride height
+// with bump positive and shock travel increasing. The ratio drifts through the travel as the arms
+// swing; until the curves are measured on the car they are the straight lines of the ratios above
+struct MotionCurvePoint {
+  float shockInches;
+  float wheelInches;
+};
+const int MOTION_CURVE_POINTS = 3;
+const MotionCurvePoint frontMotionCurve[MOTION_CURVE_POINTS] = {
+  { -4.0, -4.0 / frontMotionRatio },
+  { 0.0, 0.0 },
+  { 4.0, 4.0 / frontMotionRatio }
+};
+const MotionCurvePoint rearMotionCurve[MOTION_CURVE_POINTS] = {
+  { -4.0, -4.0 / rearMotionRatio },
+  { 0.0, 0.0 },
+  { 4.0, 4.0 / rearMotionRatio }
+};
+
+// Experimentally-found rest values of shocks, used until a rest calibration has been saved (ShockCalibration.h)
 const int frontLeftShock_restReading = 2784;
 const int frontRightShock_restReading = 2627;
 const int rearLeftShock_restReading = 2100;
@@ -22,6 +52,35 @@ const int rearRightShock_restReading = 2080;
 // Experimentally found 7 inches of travel went from 48 to 4010 which is 566 analog units per inch
 const int analogValPerInch = 566;
 
+// The ends of that experiment; the displacement table scales the corrected voltages by them instead
+const int SHOCK_TRAVEL_LOW_READING = 48;
+const int SHOCK_TRAVEL_HIGH_READING = 4010;
+const float SHOCK_TRAVEL_INCHES = 7;
+
+// analogRead() runs the ADC at 12 bits and 11 dB; this reference is only used on chips with nothing burned into eFuse
+const uint32_t SHOCK_ADC_DEFAULT_VREF_MV = 1100;
+
+// Displacement table, one entry every SHOCK_TABLE_STEP raw counts plus one to close the last interval
+const int SHOCK_TABLE_SHIFT = 5;
+const int SHOCK_TABLE_STEP = 1 << SHOCK_TABLE_SHIFT;
+const int SHOCK_TABLE_SIZE = (4096 >> SHOCK_TABLE_SHIFT) + 1;
+const int SHOCK_TABLE_INDEX_SHIFT = SHOCK_TABLE_SHIFT + SHOCK_FILTER_FRACTION_BITS;  // Table indexes from Q4 readings
+const float SHOCK_TABLE_UNITS_PER_INCH = 1000;  // Entries are thousandths of an inch
+
+// Rest calibration averages this many raw readings with the car sitting at ride height
+// (2 seconds with ShockSampler.h). Stillness is judged on the same readings run through a
+// ShockFilter: raw ESP32 readings (ADC2 especially, or with the engine idling) routinely
+// spread more than this peak to peak on a car that isn't moving, the filtered ones don't
+const int SHOCK_REST_CAL_SAMPLES = 2000;
+const int SHOCK_REST_CAL_MAX_SPREAD = 40;  // Filtered counts, ~0.07" of shock travel
+
+enum ShockRestCalibration {
+  REST_CAL_IDLE,
+  REST_CAL_RUNNING,
+  REST_CAL_DONE,    // restReading was updated; waiting for ShockCalibration.h to save it
+  REST_CAL_FAILED   // The shock moved during the window; restReading unchanged
+};
+
 // Class that defines shared variables and functions between the four wheels
 class Shock {
 
@@ -30,13 +89,26 @@ private:
   bool frontShock;  // Set true if the given shock is on the front of the car, otherwise false
   int sensorPin;    // GPIO that sensor is hooked up to
   int restReading;  // Position of the given shock while the vehicle is at rest/ride height
-  float shockPos;   // Inches that shock has traveled from rest position
-
+  int32_t wheelTable[SHOCK_TABLE_SIZE];  // Wheel travel from rest in thousandths of an inch, by raw reading
+  esp_adc_cal_characteristics_t adcCharacteristics;
+  bool adcCharacterized;
+  ShockFilter filter;  // Anti-alias/decimation for the timed samples from ShockSampler.h
+  ShockVelocity velocity;
+
+  // Rest calibration window
+  long restSum;
+  int restSamples;
+  ShockFilter restFilter;  // Separate from filter so a calibration can start at any time
+  int32_t restMinQ4;       // Filtered extremes over the window
+  int32_t restMaxQ4;
 
 public:
 
   float wheelPos;  // Inches that wheel has traveled from rest position
   int reading;     // Analog reading value from ESP32
+  float shockVelocity;  // Shaft velocity in in/s, positive in bump (timed samples only)
+  ShockVelocityHistogram histogram;  // Time spent at each shaft velocity since the last clear
+  ShockRestCalibration restCalibration;
 
   Shock(int pinNumber, bool isFrontShock, int restPositionVal) {
     sensorPin = pinNumber;
@@ -44,26 +116,139 @@ public:
     restReading = restPositionVal;
     reading = 0;
     wheelPos = 0;
-    shockPos = 0;
+    shockVelocity = 0;
+    restCalibration = REST_CAL_IDLE;
+    adcCharacterized = false;
     pinMode(sensorPin, INPUT);
+    buildWheelTable();
+  }
+
+  // Looks up this channel's eFuse ADC calibration and rebuilds the table with it. Call from setup()
+  void begin() {
+    // ADC1 is GPIO 32-39; every other analog pin is on ADC2
+    adc_unit_t unit = sensorPin >= 32 ? ADC_UNIT_1 : ADC_UNIT_2;
+    if (esp_adc_cal_characterize(unit, ADC_ATTEN_DB_11, ADC_WIDTH_BIT_12, SHOCK_ADC_DEFAULT_VREF_MV, &adcCharacteristics) == ESP_ADC_CAL_VAL_DEFAULT_VREF) {
+      Serial.println("No eFuse ADC calibration, shock readings only corrected against the default reference");
+    }
+    adcCharacterized = true;
+    buildWheelTable();
   }
 
 
+  // Reads the sensor directly (blocking, unfiltered); ShockSampler.h feeds addSample() instead
   void getPosition() {
 
     // Get initial analog reading
     reading = analogRead(sensorPin);
+    if (restCalibration == REST_CAL_RUNNING) addRestSample(reading);
+    updatePosition(int32_t(reading) << SHOCK_FILTER_FRACTION_BITS);
+  }
+
+  // Feeds one evenly spaced reading through the filter. Returns true on the readings where
+  // the filter produced a new output and wheelPos moved (every SHOCK_FILTER_DECIMATION-th)
+  bool addSample(int analogReading) {
+    reading = analogReading;
+    if (restCalibration == REST_CAL_RUNNING) addRestSample(analogReading);
+
+    int32_t filteredQ4;
+    bool filtered = filter.add(analogReading, filteredQ4);
 
-    if (frontLeftShock_restReading == 2048) {
-      Serial.println("UPDATE THE DAMN REST READINGS");
+    // Velocity runs on the faster intermediate stage; shockPos grows as the reading drops
+    float countsPerSecond;
+    if (filter.newIntermediate && velocity.add(filter.intermediateQ4, countsPerSecond)) {
+      shockVelocity = -countsPerSecond / analogValPerInch;
+      histogram.add(shockVelocity);
     }
 
-    // Convert reading to inches that sensor has traveled from rest
-    shockPos = (float)(restReading - reading) / (float)analogValPerInch;
-    if (frontShock) {
-      wheelPos = shockPos / frontMotionRatio;
-    } else {
-      wheelPos = shockPos / rearMotionRatio;
+    if (!filtered) return false;
+    updatePosition(filteredQ4);
+    return true;
+  }
+
+  int getRestReading() {
+    return restReading;
+  }
+
+  void setRestReading(int restPositionVal) {
+    restReading = restPositionVal;
+    buildWheelTable();
+  }
+
+  // Averages the next SHOCK_REST_CAL_SAMPLES readings into a new rest position
+  void startRestCalibration() {
+    restSum = 0;
+    restSamples = 0;
+    restFilter.reset();
+    restMinQ4 = INT32_MAX;
+    restMaxQ4 = INT32_MIN;
+    restCalibration = REST_CAL_RUNNING;
+  }
+
+private:
+
+  void addRestSample(int analogReading) {
+    restSum += analogReading;
+    int32_t filteredQ4;
+    if (restFilter.add(analogReading, filteredQ4)) {
+      if (filteredQ4 < restMinQ4) restMinQ4 = filteredQ4;
+      if (filteredQ4 > restMaxQ4) restMaxQ4 = filteredQ4;
+    }
+    if (++restSamples < SHOCK_REST_CAL_SAMPLES) return;
+
+    // No filtered output at all also fails (restMaxQ4 < restMinQ4 then)
+    if (restMaxQ4 < restMinQ4 || restMaxQ4 - restMinQ4 > (SHOCK_REST_CAL_MAX_SPREAD << SHOCK_FILTER_FRACTION_BITS)) {
+      restCalibration = REST_CAL_FAILED;
+      return;
     }
+    restReading = (restSum + SHOCK_REST_CAL_SAMPLES / 2) / SHOCK_REST_CAL_SAMPLES;
+    buildWheelTable();
+    restCalibration = REST_CAL_DONE;
+  }
+
+  // Sensor voltage in mV for a raw reading. Before begin() the raw counts stand in for it,
+  // which is the uncorrected linear conversion
+  float correctedReading(int analogReading) {
+    if (!adcCharacterized) return analogReading;
+    return esp_adc_cal_raw_to_voltage(analogReading, &adcCharacteristics);
+  }
+
+  // Corrected reading at a table entry. The closing entry (4096) is past the rail, so it carries
+  // on the slope of the last counts below it and the last interval is as wide as the others
+  float tableReading(int analogReading) {
+    if (analogReading <= 4095) return correctedReading(analogReading);
+    float below = correctedReading(4096 - SHOCK_TABLE_STEP);
+    return below + (correctedReading(4095) - below) * SHOCK_TABLE_STEP / (SHOCK_TABLE_STEP - 1);
+  }
+
+  // Piecewise linear through the curve, carrying the end segments on past the measured range
+  static float wheelInches(const MotionCurvePoint *curve, float shockInches) {
+    int i = 1;
+    while (i < MOTION_CURVE_POINTS - 1 && shockInches > curve[i].shockInches) i++;
+    const MotionCurvePoint &a = curve[i - 1];
+    const MotionCurvePoint &b = curve[i];
+    return a.wheelInches + (shockInches - a.shockInches) * (b.wheelInches - a.wheelInches) / (b.shockInches - a.shockInches);
+  }
+
+  // Rebuilt whenever the rest reading or the ADC correction changes, never per sample
+  void buildWheelTable() {
+    const MotionCurvePoint *curve = frontShock ? frontMotionCurve : rearMotionCurve;
+    float rest = correctedReading(restReading);
+    float perInch = (correctedReading(SHOCK_TRAVEL_HIGH_READING) - correctedReading(SHOCK_TRAVEL_LOW_READING)) / SHOCK_TRAVEL_INCHES;
+    for (int i = 0; i < SHOCK_TABLE_SIZE; i++) {
+      float shockInches = (rest - tableReading(i * SHOCK_TABLE_STEP)) / perInch;
+      wheelTable[i] = lroundf(wheelInches(curve, shockInches) * SHOCK_TABLE_UNITS_PER_INCH);
+    }
+  }
+
+  void updatePosition(int32_t readingQ4) {
+    // The filter can ring slightly past either rail; hold it at the table ends
+    if (readingQ4 < 0) readingQ4 = 0;
+    if (readingQ4 > (4095 << SHOCK_FILTER_FRACTION_BITS)) readingQ4 = 4095 << SHOCK_FILTER_FRACTION_BITS;
+    int index = readingQ4 >> SHOCK_TABLE_INDEX_SHIFT;
+    int32_t fraction = readingQ4 - (index << SHOCK_TABLE_INDEX_SHIFT);
+    // Rounded to the nearest table unit rather than always down
+    int32_t step = ((wheelTable[index + 1] - wheelTable[index]) * fraction + (1 << (SHOCK_TABLE_INDEX_SHIFT - 1))) >> SHOCK_TABLE_INDEX_SHIFT;
+    int32_t wheelTravel = wheelTable[index] + step;
+    wheelPos = wheelTravel / SHOCK_TABLE_UNITS_PER_INCH;
   }
 };
@@ -0,0 +1,81 @@
+/*
+
+  Rest position calibration for the shocks, stored in NVS.
+
+  Every setup change used to mean measuring new rest readings and reflashing. Now, with the
+  car sitting still at ride height, a calibration averages each channel over
+  SHOCK_REST_CAL_SAMPLES readings (see Shock::startRestCalibration()), saves the results in
+  NVS and they are loaded again at every boot. A channel whose readings spread too far
+  during the window (someone leaning on the car) is rejected and keeps its old rest value.
+
+  Triggers:
+    Boot: set CALIBRATE_SHOCKS_AT_BOOT in WheelSpeedSensors.ino.
+    Serial: send 'r'.
+    CAN: any node sends a nonzero int on shockCalibrationRequest_ID.
+
+  Each corner reports back on shockCalibration_ID via sendCANIndexedInt() when it finishes:
+  byte 0 is the corner (same order as the wheels), byte 1 is 1 if it was accepted and 0 if
+  rejected, and bytes 4-7 the rest reading now in use.
+
+*/
+
+#pragma once
+
+const char SHOCK_CALIBRATION_SERIAL_COMMAND = 'r';
+
+void shockRestKey(char *buffer, size_t size, int corner) {
+  snprintf(buffer, size, "rest%d", corner);
+}
+
+// Call from setup(); shocks without a saved value keep the rest reading they were constructed with
+void loadShockRestReadings(Shock *shocks[WHEEL_COUNT]) {
+  Preferences preferences;
+  preferences.begin("shockcal", true);
+  for (int i = 0; i < WHEEL_COUNT; i++) {
+    char key[16];
+    shockRestKey(key, sizeof(key), i);
+    int rest = preferences.getInt(key, -1);
+    if (rest >= 0) {
+      shocks[i]->setRestReading(rest);
+    }
+  }
+  preferences.end();
+}
+
+void startShockRestCalibration(Shock *shocks[WHEEL_COUNT]) {
+  Serial.println("Shock rest calibration started, keep the car still");
+  for (int i = 0; i < WHEEL_COUNT; i++) {
+    shocks[i]->startRestCalibration();
+  }
+}
+
+// Call from loop(); starts a calibration when asked over CAN and saves/reports finished ones
+void serviceShockCalibration(Shock *shocks[WHEEL_COUNT]) {
+  if (shockCalibrationRequest != 0) {
+    shockCalibrationRequest = 0;
+    startShockRestCalibration(shocks);
+  }
+
+  for (int i = 0; i < WHEEL_COUNT; i++) {
+    Shock &shock = *shocks[i];
+    if (shock.restCalibration != REST_CAL_DONE && shock.restCalibration != REST_CAL_FAILED) continue;
+
+    bool accepted = shock.restCalibration == REST_CAL_DONE;
+    if (accepted) {
+      Preferences preferences;
+      char key[16];
+      shockRestKey(key, sizeof(key), i);
+      preferences.begin("shockcal", false);
+      preferences.putInt(key, shock.getRestReading());
+      preferences.end();
+    }
+
+    Serial.print("Shock ");
+    Serial.print(i);
+    Serial.print(accepted ? " rest reading saved: " : " moved during calibration, keeping rest reading ");
+    Serial.println(shock.getRestReading());
+    sendCANIndexedInt(shockCalibration_ID, i, accepted ? 1 : 0, shock.getRestReading());
+
+    shock.restCalibration = REST_CAL_IDLE;
+  }
+}
@@ -0,0 +1,134 @@
+/*
+
+  Anti-alias and decimation filter for one shock channel.
+
+  The shocks are sampled at SHOCK_SAMPLE_RATE_HZ by ShockSampler.h but published at the
+  100 Hz CAN rate. Just keeping every 10th raw reading would fold chassis vibration above
+  50 Hz straight into the data, and a single 12-bit reading is noisy on its own, so every
+  sample goes through:
+
+    1 kHz -> 3rd order CIC, decimate by 5 -> 200 Hz -> 23 tap FIR, decimate by 2 -> 100 Hz
+
+  The CIC is only adds and subtracts at the input rate and puts deep nulls on everything
+  that would alias onto DC from 200 Hz multiples. The FIR does the real low-pass and only
+  runs at the output rate (every other 200 Hz sample), so the whole chain costs a few
+  dozen cycles per raw sample (see WheelBenchmark.h on the car, and test/ShockFilterTest,
+  which also checks the response below, on a PC).
+
+  Response, CIC and FIR together: -0.4 dB at 20 Hz, -3 dB at 30 Hz, below -50 dB from
+  50 Hz (everything that would alias at 100 Hz). Delay is about 60 ms.
+
+  Output is ADC counts in Q4 so the averaging gain isn't thrown away before the conversion
+  to inches.
+
+*/
+
+#pragma once
+
+const uint32_t SHOCK_SAMPLE_RATE_HZ = 1000;  // Raw sample rate ShockSampler.h runs at
+const uint32_t SHOCK_OUTPUT_RATE_HZ = 100;   // The CAN send rate
+
+const int SHOCK_CIC_ORDER = 3;
+const int SHOCK_CIC_DECIMATION = 5;
+const int SHOCK_FIR_DECIMATION = 2;
+const int SHOCK_FILTER_DECIMATION = SHOCK_CIC_DECIMATION * SHOCK_FIR_DECIMATION;
+const int SHOCK_FILTER_FRACTION_BITS = 4;
+
+// The coefficients below are designed for these rates; redesign them if either changes
+static_assert(SHOCK_SAMPLE_RATE_HZ == SHOCK_OUTPUT_RATE_HZ * SHOCK_FILTER_DECIMATION, "Shock filter decimation doesn't match the sample and output rates");
+
+// CIC DC gain is SHOCK_CIC_DECIMATION ^ SHOCK_CIC_ORDER
+constexpr int32_t cicGain(int order) {
+  return order == 0 ? 1 : SHOCK_CIC_DECIMATION * cicGain(order - 1);
+}
+const int32_t SHOCK_CIC_GAIN = cicGain(SHOCK_CIC_ORDER);
+
+// The integrators wrap in 32 bits, which is fine as long as one output fits
+static_assert(4096LL * SHOCK_CIC_GAIN < 2147483648LL, "CIC output overflows 32 bits");
+
+// Hamming windowed sinc, 35 Hz cutoff at 200 Hz, Q15, symmetric and summing to exactly 32768
+const int SHOCK_FIR_TAPS = 23;
+const int16_t SHOCK_FIR_Q15[SHOCK_FIR_TAPS] = {
+  -35, -103, -81, 184, 515, 256, -896, -1818, -459, 3923, 9147, 11502,
+  9147, 3923, -459, -1818, -896, 256, 515, 184, -81, -103, -35
+};
+
+class ShockFilter {
+
+private:
+
+  uint32_t integrators[SHOCK_CIC_ORDER];
+  uint32_t combDelays[SHOCK_CIC_ORDER];
+  int cicPhase;
+
+  int32_t firHistory[SHOCK_FIR_TAPS];  // Q4 counts at the CIC output rate, newest at firIndex
+  int firIndex;
+  int firPhase;
+  int firFill;  // Outputs are held back until the CIC has settled and the history has been filled once
+
+public:
+
+  // CIC output at SHOCK_SAMPLE_RATE_HZ / SHOCK_CIC_DECIMATION, for stages (ShockVelocity.h) that
+  // want more bandwidth than the 100 Hz output. Only valid right after an add() that set newIntermediate
+  int32_t intermediateQ4;
+  bool newIntermediate;
+
+  ShockFilter() {
+    reset();
+  }
+
+  void reset() {
+    memset(integrators, 0, sizeof(integrators));
+    memset(combDelays, 0, sizeof(combDelays));
+    memset(firHistory, 0, sizeof(firHistory));
+    cicPhase = 0;
+    firIndex = 0;
+    firPhase = 0;
+    firFill = 0;
+    intermediateQ4 = 0;
+    newIntermediate = false;
+  }
+
+  // Feeds one raw reading. Returns true and sets outputQ4 every SHOCK_FILTER_DECIMATION readings
+  bool add(int reading, int32_t &outputQ4) {
+    newIntermediate = false;
+    uint32_t value = reading;
+    for (int i = 0; i < SHOCK_CIC_ORDER; i++) {
+      integrators[i] += value;
+      value = integrators[i];
+    }
+    if (++cicPhase < SHOCK_CIC_DECIMATION) return false;
+    cicPhase = 0;
+
+    for (int i = 0; i < SHOCK_CIC_ORDER; i++) {
+      uint32_t delayed = combDelays[i];
+      combDelays[i] = value;
+      value -= delayed;
+    }
+
+    firIndex = (firIndex + 1) % SHOCK_FIR_TAPS;
+    firHistory[firIndex] = (int32_t(value) << SHOCK_FILTER_FRACTION_BITS) / SHOCK_CIC_GAIN;
+    if (firFill < SHOCK_CIC_ORDER + SHOCK_FIR_TAPS) firFill++;
+    if (firFill > SHOCK_CIC_ORDER) {
+      intermediateQ4 = firHistory[firIndex];
+      newIntermediate = true;
+    }
+    if (++firPhase < SHOCK_FIR_DECIMATION) return false;
+    firPhase = 0;
+    if (firFill < SHOCK_CIC_ORDER + SHOCK_FIR_TAPS) return false;
+
+    // Symmetric taps: add the mirrored pair first and multiply once
+    int64_t sum = 0;
+    int newest = firIndex;
+    int oldest = (firIndex + 1) % SHOCK_FIR_TAPS;
+    for (int i = 0; i < SHOCK_FIR_TAPS / 2; i++) {
+      sum += int64_t(SHOCK_FIR_Q15[i]) * (firHistory[newest] + firHistory[oldest]);
+      newest = newest == 0 ? SHOCK_FIR_TAPS - 1 : newest - 1;
+      oldest = oldest == SHOCK_FIR_TAPS - 1 ? 0 : oldest + 1;
+    }
+    sum += int64_t(SHOCK_FIR_Q15[SHOCK_FIR_TAPS / 2]) * firHistory[newest];
+
+    outputQ4 = int32_t((sum + (1 << 14)) >> 15);
+    return true;
+  }
+};
@@ -0,0 +1,67 @@
+/*
+
+  On-demand reporting of the shock velocity histograms (ShockVelocity.h).
+
+  Serial: send 'h' to print all four corners, 'H' to clear them before a run.
+
+  CAN: any node sends an int on shockHistogramRequest_ID with a bitmask of the corners it
+  wants (bit 0 = front left ... bit 3 = rear right, same as the wheels) plus
+  SHOCK_HISTOGRAM_CLEAR_REQUEST to clear them once they have been sent. Each bin comes back
+  as its own frame on shockHistogram_ID via sendCANIndexedInt(): byte 0 is the corner,
+  byte 1 the bin (the SHOCK_VELOCITY_BINS bump bins, then the rebound bins) and bytes 4-7
+  the count.
+
+*/
+
+#pragma once
+
+const char SHOCK_HISTOGRAM_SERIAL_COMMAND = 'h';
+const char SHOCK_HISTOGRAM_CLEAR_SERIAL_COMMAND = 'H';
+const int SHOCK_HISTOGRAM_CLEAR_REQUEST = 0x80;
+
+void printShockHistogram(const char *label, Shock &shock) {
+  Serial.print(label);
+  Serial.print(" velocity histogram (in/s, ");
+  Serial.print(SHOCK_VELOCITY_RATE_HZ);
+  Serial.println(" counts per second)");
+
+  for (int i = SHOCK_VELOCITY_BINS - 1; i >= 0; i--) {
+    Serial.print("  rebound ");
+    Serial.print(i * SHOCK_VELOCITY_BIN_WIDTH, 1);
+    Serial.print(i == SHOCK_VELOCITY_BINS - 1 ? "+" : "");
+    Serial.print(": ");
+    Serial.println(shock.histogram.rebound[i]);
+  }
+  for (int i = 0; i < SHOCK_VELOCITY_BINS; i++) {
+    Serial.print("  bump ");
+    Serial.print(i * SHOCK_VELOCITY_BIN_WIDTH, 1);
+    Serial.print(i == SHOCK_VELOCITY_BINS - 1 ? "+" : "");
+    Serial.print(": ");
+    Serial.println(shock.histogram.bump[i]);
+  }
+}
+
+void sendShockHistogramCAN(int corner, Shock &shock) {
+  for (int i = 0; i < SHOCK_VELOCITY_BINS; i++) {
+    sendCANIndexedInt(shockHistogram_ID, corner, i, shock.histogram.bump[i]);
+  }
+  for (int i = 0; i < SHOCK_VELOCITY_BINS; i++) {
+    sendCANIndexedInt(shockHistogram_ID, corner, SHOCK_VELOCITY_BINS + i, shock.histogram.rebound[i]);
+  }
+}
+
+// Call from loop(); does nothing unless a report was asked for over CAN
+void serviceShockHistograms(Shock *shocks[WHEEL_COUNT]) {
+  // Taken in one step, as in serviceWheelDiagnostics()
+  int requested = shockHistogramRequest.exchange(0);
+  if (requested == 0) return;
+
+  for (int i = 0; i < WHEEL_COUNT; i++) {
+    if (requested & (1 << i)) {
+      sendShockHistogramCAN(i, *shocks[i]);
+      if (requested & SHOCK_HISTOGRAM_CLEAR_REQUEST) {
+        shocks[i]->histogram.clear();
+      }
+    }
+  }
+}
@@ -0,0 +1,119 @@
+/*
+
+  Fixed-rate sampling of the four shock potentiometers.
+
+  Reading the shocks with analogRead() from loop() gave a sample rate of whatever the loop
+  happened to run at, with each read stalling it. Here a periodic esp_timer wakes a small
+  task on core 0 every 1/SHOCK_SAMPLE_RATE_HZ (set in ShockFilter.h, which is designed
+  for it); it reads all four channels back to back, stamps the set with one wheelMicros()
+  sample and pushes it into a ring that loop() drains in blocks. Samples are evenly spaced
+  no matter what loop() is doing, which is what velocity and frequency analysis need.
+
+  The ESP32's continuous (DMA) ADC mode would be the obvious tool, but on this chip it
+  only drives ADC1, and two of the shock pins (27 and 13) are on ADC2. Until the harness is
+  moved to ADC1 pins the channels are read one at a time, roughly 100us per set.
+
+  The esp_timer callback only notifies the task: the reads take too long for the shared
+  esp_timer task, and ADC2 reads take a lock that can't be taken from an ISR.
+
+*/
+
+#pragma once
+
+const unsigned int SHOCK_QUEUE_SIZE = 256;  // ~250ms of loop() stall at 1 kHz before samples are dropped
+const int SHOCK_COUNT = 4;
+
+const UBaseType_t SHOCK_TASK_PRIORITY = 4;  // Above the CAN task (1) it shares core 0 with
+const uint32_t SHOCK_TASK_STACK_SIZE = 3072;
+const BaseType_t SHOCK_TASK_CORE = 0;       // Keeps core 1 for the wheel task
+
+// Channel order is the order of the pins passed to ShockSampler::begin()
+struct ShockSample {
+  WheelMicros micros;  // Taken just before the first channel is read
+  uint16_t reading[SHOCK_COUNT];
+};
+
+class ShockSampler {
+
+private:
+
+  int pins[SHOCK_COUNT];
+  SpscRing<ShockSample, SHOCK_QUEUE_SIZE> samples;
+  TaskHandle_t taskHandle;
+  esp_timer_handle_t timer;
+
+  static void onTimer(void *parameters) {
+    ShockSampler *sampler = (ShockSampler *)parameters;
+    xTaskNotifyGive(sampler->taskHandle);
+  }
+
+  static void taskCode(void *parameters) {
+    ((ShockSampler *)parameters)->run();
+  }
+
+  void run() {
+    for (;;) {
+      // More than one pending tick means the task was held off and those periods were never sampled
+      uint32_t ticks = ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+      if (ticks > 1) {
+        missedTicks = missedTicks + (ticks - 1);
+      }
+
+      ShockSample sample;
+      sample.micros = wheelMicros();
+      for (int i = 0; i < SHOCK_COUNT; i++) {
+        sample.reading[i] = analogRead(pins[i]);
+      }
+
+      if (!samples.push(sample)) {
+        droppedSamples = droppedSamples + 1;
+      }
+    }
+  }
+
+public:
+
+  volatile unsigned long missedTicks;     // Periods skipped because the task couldn't keep up
+  volatile unsigned long droppedSamples;  // Samples lost because loop() fell behind
+
+  ShockSampler() {
+    taskHandle = NULL;
+    timer = NULL;
+    missedTicks = 0;
+    droppedSamples = 0;
+  }
+
+  void begin(int frontLeftPin, int frontRightPin, int rearLeftPin, int rearRightPin) {
+    pins[0] = frontLeftPin;
+    pins[1] = frontRightPin;
+    pins[2] = rearLeftPin;
+    pins[3] = rearRightPin;
+    for (int i = 0; i < SHOCK_COUNT; i++) {
+      pinMode(pins[i], INPUT);
+    }
+
+    xTaskCreatePinnedToCore(
+      taskCode,
+      "Shock_Task",
+      SHOCK_TASK_STACK_SIZE,
+      this,
+      SHOCK_TASK_PRIORITY,
+      &taskHandle,
+      SHOCK_TASK_CORE);
+
+    esp_timer_create_args_t timerArgs;
+    memset(&timerArgs, 0, sizeof(timerArgs));
+    timerArgs.callback = onTimer;
+    timerArgs.arg = this;
+    timerArgs.dispatch_method = ESP_TIMER_TASK;
+    timerArgs.name = "shock_sample";
+    if (esp_timer_create(&timerArgs, &timer) != ESP_OK || esp_timer_start_periodic(timer, 1000000 / SHOCK_SAMPLE_RATE_HZ) != ESP_OK) {
+      Serial.println("Failed to start shock sample timer");
+    }
+  }
+
+  // Consumer side, call from loop(). Returns false once the ring is empty
+  bool read(ShockSample &sample) {
+    return samples.pop(sample);
+  }
+};
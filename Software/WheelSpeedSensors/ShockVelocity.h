@@ -0,0 +1,89 @@
+/*
+
+  Damper (shaft) velocity and bump/rebound velocity histograms.
+
+  Dampers are tuned from how much time the shaft spends at each velocity, and building that
+  offline from 100 Hz positions is too coarse. Instead the velocity is differentiated from
+  the 200 Hz CIC stage of ShockFilter with a 9 point Savitzky-Golay derivative (a least
+  squares slope over 45 ms, which doubles as the low-pass; 20 ms delay) and every value
+  lands in a fixed-bin histogram on the device.
+
+  Positive velocity is bump (compression, shockPos increasing), negative is rebound. Bins
+  are SHOCK_VELOCITY_BIN_WIDTH wide starting at zero in each direction, and the last bin
+  also counts everything faster. Each count is 1/SHOCK_VELOCITY_RATE_HZ of time. See
+  ShockHistograms.h for getting them off the car.
+
+*/
+
+#pragma once
+
+const int SHOCK_VELOCITY_POINTS = 9;
+const int SHOCK_VELOCITY_DENOMINATOR = 60;  // Sum of k^2 for k = -4..4
+const uint32_t SHOCK_VELOCITY_RATE_HZ = SHOCK_SAMPLE_RATE_HZ / SHOCK_CIC_DECIMATION;
+
+const float SHOCK_VELOCITY_BIN_WIDTH = 0.5;  // in/s
+const int SHOCK_VELOCITY_BINS = 20;          // Per direction; the last one starts at 9.5 in/s
+
+// Least squares slope over the last SHOCK_VELOCITY_POINTS positions
+class ShockVelocity {
+
+private:
+
+  int32_t history[SHOCK_VELOCITY_POINTS];  // Q4 ADC counts, oldest at index
+  int index;
+  int fill;
+
+public:
+
+  ShockVelocity() {
+    memset(history, 0, sizeof(history));
+    index = 0;
+    fill = 0;
+  }
+
+  // Returns false until the window has filled; countsPerSecond is in (unscaled) ADC counts
+  bool add(int32_t positionQ4, float &countsPerSecond) {
+    history[index] = positionQ4;
+    index = (index + 1) % SHOCK_VELOCITY_POINTS;
+    if (fill < SHOCK_VELOCITY_POINTS) {
+      fill++;
+      if (fill < SHOCK_VELOCITY_POINTS) return false;
+    }
+
+    // index is now the oldest sample, weight -4
+    int32_t sum = 0;
+    int slot = index;
+    for (int k = -(SHOCK_VELOCITY_POINTS / 2); k <= SHOCK_VELOCITY_POINTS / 2; k++) {
+      sum += k * history[slot];
+      slot = slot == SHOCK_VELOCITY_POINTS - 1 ? 0 : slot + 1;
+    }
+
+    countsPerSecond = float(sum) * SHOCK_VELOCITY_RATE_HZ / (SHOCK_VELOCITY_DENOMINATOR << SHOCK_FILTER_FRACTION_BITS);
+    return true;
+  }
+};
+
+struct ShockVelocityHistogram {
+  unsigned long bump[SHOCK_VELOCITY_BINS];
+  unsigned long rebound[SHOCK_VELOCITY_BINS];
+
+  ShockVelocityHistogram() {
+    clear();
+  }
+
+  void clear() {
+    memset(bump, 0, sizeof(bump));
+    memset(rebound, 0, sizeof(rebound));
+  }
+
+  void add(float inchesPerSecond) {
+    float speed = inchesPerSecond >= 0 ? inchesPerSecond : -inchesPerSecond;
+    int bin = int(speed / SHOCK_VELOCITY_BIN_WIDTH);
+    if (bin >= SHOCK_VELOCITY_BINS) bin = SHOCK_VELOCITY_BINS - 1;
+    if (inchesPerSecond >= 0) {
+      bump[bin]++;
+    } else {
+      rebound[bin]++;
+    }
+  }
+};
@@ -0,0 +1,141 @@
+/*
+
+  Sprag clutch engagement, wheel by wheel.
+
+  Under power every sprag locks its wheel to the driveline, so all engaged wheels turn at
+  the same driveline speed, and a wheel turning faster than that is overrunning (the
+  outside wheels through a corner, for example). Off throttle the sprags can't carry any
+  torque and every wheel runs free.
+
+  There is no driveline speed sensor on this board, so the slowest wheel stands in for it
+  while the throttle is down: an engaged wheel can't turn slower than the driveline, and
+  at least one wheel is always engaged while driving. A wheel that stays within the
+  coherence band of the slowest wheel is engaged; one that pulls away above it is
+  overrunning. The band to engage is tighter than the band to release so a wheel riding
+  the edge doesn't flicker.
+
+  A new state has to hold for SPRAG_CONFIRM_MICROS before it counts, but the transition is
+  timestamped with when it first appeared. Transitions are queued for loop(), which sends
+  each one on spragTransition_ID via sendCANIndexedInt(): byte 0 is the WheelPosition,
+  byte 1 is 1 for engaged / 0 for overrunning and bytes 4-7 the time in milliseconds
+  since boot. spragEngagement carries the current state of all four wheels as a bitmask
+  (bit 0 = front left ... bit 3 = rear right) at the normal CAN rate, as byte 4 of the
+  wheelStates_ID frame.
+
+*/
+
+#pragma once
+
+const int SPRAG_THROTTLE_PERCENT = 10;           // gasPedalPercentage above this means the driveline is driving the wheels
+const float SPRAG_MIN_SPEED_MPH = 2;             // Below this the wheel speeds are too coarse to compare; states are held
+const float SPRAG_ENGAGE_BAND_FRACTION = 0.03;   // Within this fraction of the slowest wheel to engage...
+const float SPRAG_RELEASE_BAND_FRACTION = 0.06;  // ...and beyond this to release
+const float SPRAG_BAND_MIN_MPH = 0.5;            // Engage band floor (speed resolution at low speed); release is twice this
+const unsigned long SPRAG_CONFIRM_MICROS = 20000;
+
+// Transitions waiting for loop() to send them; a burst across all four wheels fits several times over
+const unsigned int SPRAG_TRANSITION_QUEUE_SIZE = 32;
+
+struct SpragTransition {
+  WheelMicros micros;  // When the wheel first looked like its new state
+  uint8_t position;    // WheelPosition
+  bool engaged;
+};
+
+class SpragDetector {
+
+private:
+
+  volatile int throttlePercent;  // Written by loop() from CAN
+
+  bool pending[WHEEL_COUNT];
+  WheelMicros pendingSinceMicros[WHEEL_COUNT];
+
+  SpscRing<SpragTransition, SPRAG_TRANSITION_QUEUE_SIZE> transitions;
+
+public:
+
+  bool engaged[WHEEL_COUNT];
+  WheelMicros lastTransitionMicros[WHEEL_COUNT];
+  unsigned long engagements[WHEEL_COUNT];  // Overrunning to engaged transitions since boot
+  unsigned long droppedTransitions;        // Transitions lost because loop() fell behind
+
+  SpragDetector() {
+    throttlePercent = 0;
+    droppedTransitions = 0;
+    for (int i = 0; i < WHEEL_COUNT; i++) {
+      engaged[i] = false;
+      pending[i] = false;
+      pendingSinceMicros[i] = 0;
+      lastTransitionMicros[i] = 0;
+      engagements[i] = 0;
+    }
+  }
+
+  // Call from loop() with the CAN variable
+  void setThrottle(int gasPedalPercentage) {
+    throttlePercent = gasPedalPercentage;
+  }
+
+  // Call from the wheel task after every WheelBank update
+  void update(const WheelSnapshot &wheels) {
+    float slowestMPH = wheels.speedMPH[0];
+    for (int i = 1; i < WHEEL_COUNT; i++) {
+      if (wheels.speedMPH[i] < slowestMPH) slowestMPH = wheels.speedMPH[i];
+    }
+
+    bool driving = throttlePercent > SPRAG_THROTTLE_PERCENT;
+    if (driving && slowestMPH < SPRAG_MIN_SPEED_MPH) {
+      return;
+    }
+
+    float engageBand = slowestMPH * SPRAG_ENGAGE_BAND_FRACTION;
+    float releaseBand = slowestMPH * SPRAG_RELEASE_BAND_FRACTION;
+    if (engageBand < SPRAG_BAND_MIN_MPH) engageBand = SPRAG_BAND_MIN_MPH;
+    if (releaseBand < 2 * SPRAG_BAND_MIN_MPH) releaseBand = 2 * SPRAG_BAND_MIN_MPH;
+
+    for (int i = 0; i < WHEEL_COUNT; i++) {
+      bool target = false;
+      if (driving) {
+        float aboveSlowest = wheels.speedMPH[i] - slowestMPH;
+        target = aboveSlowest < (engaged[i] ? releaseBand : engageBand);
+      }
+
+      if (target != pending[i]) {
+        pending[i] = target;
+        pendingSinceMicros[i] = wheels.sampleMicros;
+      }
+
+      if (pending[i] != engaged[i] && wheels.sampleMicros - pendingSinceMicros[i] >= WheelMicros(SPRAG_CONFIRM_MICROS)) {
+        engaged[i] = pending[i];
+        lastTransitionMicros[i] = pendingSinceMicros[i];
+        if (engaged[i]) engagements[i]++;
+
+        SpragTransition transition;
+        transition.micros = pendingSinceMicros[i];
+        transition.position = i;
+        transition.engaged = engaged[i];
+        if (!transitions.push(transition)) {
+          droppedTransitions++;
+        }
+      }
+    }
+  }
+
+  // Bit per engaged wheel, in WheelPosition order
+  int engagementMask() {
+    int mask = 0;
+    for (int i = 0; i < WHEEL_COUNT; i++) {
+      if (engaged[i]) mask |= 1 << i;
+    }
+    return mask;
+  }
+
+  // Call from loop(); sends every transition queued since the last call
+  void sendTransitionsCAN() {
+    SpragTransition transition;
+    while (transitions.pop(transition)) {
+      sendCANIndexedInt(spragTransition_ID, transition.position, transition.engaged ? 1 : 0, (int)(transition.micros / 1000));
+    }
+  }
+};
@@ -0,0 +1,56 @@
+/*
+
+  Lock-free single-producer/single-consumer ring buffer.
+
+  The producer (an ISR) only ever writes headIndex and the consumer (loop) only ever
+  writes tailIndex, so neither side has to disable interrupts. Indices are free-running
+  counters that are masked into the array, which is why Size must be a power of two.
+
+*/
+
+#pragma once
+
+#include <atomic>
+
+template <typename T, unsigned int Size>
+class SpscRing {
+
+  static_assert(Size > 0 && (Size & (Size - 1)) == 0, "SpscRing size must be a power of two");
+
+private:
+
+  T items[Size];
+  std::atomic<unsigned int> headIndex;  // Next slot the producer will write
+  std::atomic<unsigned int> tailIndex;  // Next slot the consumer will read
+
+public:
+
+  SpscRing()
+    : headIndex(0), tailIndex(0) {}
+
+  // Producer side. Returns false (and drops the item) if the ring is full
+  bool push(const T &item) {
+    unsigned int head = headIndex.load(std::memory_order_relaxed);
+    if (head - tailIndex.load(std::memory_order_acquire) >= Size) {
+      return false;
+    }
+    items[head & (Size - 1)] = item;
+    headIndex.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side. Returns false if there was nothing to read
+  bool pop(T &item) {
+    unsigned int tail = tailIndex.load(std::memory_order_relaxed);
+    if (tail == headIndex.load(std::memory_order_acquire)) {
+      return false;
+    }
+    item = items[tail & (Size - 1)];
+    tailIndex.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool isEmpty() const {
+    return tailIndex.load(std::memory_order_acquire) == headIndex.load(std::memory_order_acquire);
+  }
+};
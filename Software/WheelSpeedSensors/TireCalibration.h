@@ -0,0 +1,170 @@
+/*
+
+  Tire rolling-radius calibration against GPS.
+
+  Every speed is derived from the nominal wheelDiameter, but tire growth, pressure and wear
+  move the effective rolling diameter by a few percent, and that shifts every speed, slip
+  and reference number with it. While driving straight at a steady speed with GPS showing
+  we're moving, each wheel's published speed is regressed against GPS speed (least squares
+  through the origin) over TIRE_CAL_BATCH_SAMPLES samples. The slope is how far that wheel's
+  tireScale is off; a limited step toward it is taken after every batch.
+
+  gpsVelocity only arrives in whole m/s, so a single sample is worth very little. The batch
+  is long enough that the natural speed variation dithers that away, but any bias in how
+  the DAS rounds it ends up in the result.
+
+  The scales are saved to NVS (next to the tooth tables) once the car stops after a change,
+  since flash writes stall the CPU, and restored by load() at boot.
+
+*/
+
+#pragma once
+
+const float TIRE_CAL_MIN_GPS_MPH = 10;            // GPS quantization is ~2.2 MPH, so only use it well above that
+const float TIRE_CAL_MAX_YAW_DPS = 3;             // |gyroscopeYaw| below this counts as straight
+const float TIRE_CAL_MAX_ACCEL_MPHPS = 1;         // |accelerationX| below this counts as steady (GPS lags the wheels)
+const float TIRE_CAL_MAX_GPS_ERROR = 0.15;        // Every wheel within this fraction (plus one GPS step) of GPS, i.e. rolling
+const unsigned long TIRE_CAL_SAMPLE_MICROS = 100000;  // Roughly the GPS update rate
+const unsigned long TIRE_CAL_BATCH_SAMPLES = 1200;    // 2 minutes of qualifying driving per correction
+const float TIRE_CAL_GAIN = 0.5;                  // Fraction of each batch's correction applied
+const float TIRE_CAL_MAX_STEP = 0.02;             // Largest change to a scale from one batch
+const float TIRE_CAL_MIN_SCALE = 0.9;             // Scales outside this range mean something other than the tire is wrong
+const float TIRE_CAL_MAX_SCALE = 1.1;
+
+class TireCalibrator {
+
+private:
+
+  WheelBank &bank;
+
+  // Latest CAN values, written by loop() and read by the wheel task
+  volatile float yawRateDPS;
+  volatile float accelerationMPHps;
+  volatile float gpsSpeedMPH;
+
+  WheelMicros lastSampleMicros;
+  float sumWheelGps[WHEEL_COUNT];    // Sum of wheel * GPS
+  float sumWheelSquared[WHEEL_COUNT];
+  unsigned long sampleCount;
+  bool unsaved;
+
+  void key(char *buffer, size_t size, int position) {
+    snprintf(buffer, size, "tire%d", bank.wheel(position).sensorPin);
+  }
+
+  // Rolling is judged against GPS rather than slipRatio: slip is measured against the other
+  // wheels, so a tire whose size is a few percent off would look like it was always slipping
+  // and never get calibrated. The band is wider than the scale clamp for the same reason
+  bool steady(const WheelSnapshot &wheels, float gps) {
+    if (gps < TIRE_CAL_MIN_GPS_MPH) return false;
+    if (fabsf(yawRateDPS) > TIRE_CAL_MAX_YAW_DPS) return false;
+    if (fabsf(accelerationMPHps) > TIRE_CAL_MAX_ACCEL_MPHPS) return false;
+    float tolerance = TIRE_CAL_MAX_GPS_ERROR * gps + GPS_VELOCITY_TO_MPH;
+    for (int i = 0; i < WHEEL_COUNT; i++) {
+      if (fabsf(wheels.speedMPH[i] - gps) > tolerance) return false;
+    }
+    return true;
+  }
+
+  bool stopped(const WheelSnapshot &wheels) {
+    for (int i = 0; i < WHEEL_COUNT; i++) {
+      if (wheels.speedMPH[i] != 0) return false;
+    }
+    return true;
+  }
+
+  void applyBatch() {
+    for (int i = 0; i < WHEEL_COUNT; i++) {
+      if (sumWheelSquared[i] <= 0) continue;
+      float correction = TIRE_CAL_GAIN * (sumWheelGps[i] / sumWheelSquared[i] - 1.0);
+      if (correction > TIRE_CAL_MAX_STEP) correction = TIRE_CAL_MAX_STEP;
+      if (correction < -TIRE_CAL_MAX_STEP) correction = -TIRE_CAL_MAX_STEP;
+
+      VehicleWheel &w = bank.wheel(i);
+      float scale = w.tireScale * (1.0 + correction);
+      if (scale < TIRE_CAL_MIN_SCALE) scale = TIRE_CAL_MIN_SCALE;
+      if (scale > TIRE_CAL_MAX_SCALE) scale = TIRE_CAL_MAX_SCALE;
+      w.tireScale = scale;
+    }
+    unsaved = true;
+    resetBatch();
+  }
+
+  void resetBatch() {
+    for (int i = 0; i < WHEEL_COUNT; i++) {
+      sumWheelGps[i] = 0;
+      sumWheelSquared[i] = 0;
+    }
+    sampleCount = 0;
+  }
+
+public:
+
+  TireCalibrator(WheelBank &wheelBank)
+    : bank(wheelBank) {
+    yawRateDPS = 0;
+    accelerationMPHps = 0;
+    gpsSpeedMPH = 0;
+    lastSampleMicros = 0;
+    unsaved = false;
+    resetBatch();
+  }
+
+  // Call from loop() with the CAN variables
+  void setInputs(float gyroscopeYaw, float accelerationX, int gpsVelocity) {
+    yawRateDPS = gyroscopeYaw;
+    accelerationMPHps = accelerationX * IMU_ACCEL_TO_MPHPS;
+    gpsSpeedMPH = gpsVelocity * GPS_VELOCITY_TO_MPH;
+  }
+
+  // Restores the scales saved by save(). Call from setup() before the wheel task starts
+  void load() {
+    Preferences preferences;
+    preferences.begin("wheelcal", true);
+    for (int i = 0; i < WHEEL_COUNT; i++) {
+      char name[16];
+      key(name, sizeof(name), i);
+      float scale = preferences.getFloat(name, 1.0);
+      if (scale >= TIRE_CAL_MIN_SCALE && scale <= TIRE_CAL_MAX_SCALE) {
+        bank.wheel(i).tireScale = scale;
+      }
+    }
+    preferences.end();
+  }
+
+  void save() {
+    Preferences preferences;
+    preferences.begin("wheelcal", false);
+    for (int i = 0; i < WHEEL_COUNT; i++) {
+      char name[16];
+      key(name, sizeof(name), i);
+      preferences.putFloat(name, bank.wheel(i).tireScale);
+    }
+    preferences.end();
+    unsaved = false;
+  }
+
+  // Call from the wheel task after every WheelBank update
+  void update(const WheelSnapshot &wheels) {
+    if (wheels.sampleMicros - lastSampleMicros < WheelMicros(TIRE_CAL_SAMPLE_MICROS)) return;
+    lastSampleMicros = wheels.sampleMicros;
+
+    // Flash writes stall the CPU, so only persist once every wheel has timed out to zero
+    if (unsaved && stopped(wheels)) {
+      save();
+    }
+
+    float gps = gpsSpeedMPH;
+    if (!steady(wheels, gps)) return;
+
+    for (int i = 0; i < WHEEL_COUNT; i++) {
+      sumWheelGps[i] += wheels.speedMPH[i] * gps;
+      sumWheelSquared[i] += wheels.speedMPH[i] * wheels.speedMPH[i];
+    }
+    sampleCount++;
+
+    if (sampleCount >= TIRE_CAL_BATCH_SAMPLES) {
+      applyBatch();
+    }
+  }
+};
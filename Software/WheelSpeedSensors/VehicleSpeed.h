@@ -0,0 +1,118 @@
+/*
+
+  Reference vehicle speed for the spin/skid check.
+
+  checkWheelState() needs to know how fast the car is really going. GPS on its own only
+  updates a few times a second and comes over CAN in whole m/s, so instead this estimate is
+  recomputed on every WheelBank update from:
+
+    - The wheels. While driving a spinning wheel reads fast, so we follow the second-slowest
+      wheel; while braking a locking wheel reads slow, so we follow the second-fastest. One
+      wheel misbehaving (and usually a second) can't drag the reference with it.
+    - The IMU's longitudinal acceleration, integrated between updates. This carries the
+      estimate when the wheel reference itself is wrong (all four spinning off the line or
+      locked under hard braking), which shows up as the wheel reference running away from
+      the integrated speed by more than REFERENCE_WHEEL_GATE_MPH.
+    - GPS, only while the wheel reference is rejected, so a long all-wheel slide doesn't
+      leave the estimate to drift on the integrated IMU alone.
+
+  The IMU, GPS and brake pedal values come over CAN, so loop() hands them in with setInputs()
+  and the wheel task picks up the latest ones on its next update.
+
+*/
+
+#pragma once
+
+const float IMU_ACCEL_TO_MPHPS = 2.23694;   // accelerationX arrives in m/s^2
+const float GPS_VELOCITY_TO_MPH = 2.23694;  // gpsVelocity arrives in whole m/s
+
+const int REFERENCE_BRAKING_PEDAL_PERCENT = 10;  // Above this the braking (second-fastest) wheel is used
+
+const float REFERENCE_WHEEL_TIME_CONSTANT = 0.05;  // Seconds to follow the wheel reference
+const float REFERENCE_SLIP_TIME_CONSTANT = 1.0;    // Same, while the wheel reference is rejected
+const float REFERENCE_GPS_TIME_CONSTANT = 2.0;     // Seconds to follow GPS while the wheel reference is rejected
+const float REFERENCE_WHEEL_GATE_MPH = 3;          // Wheel reference this far from the IMU prediction is rejected
+
+// A stalled wheel task shouldn't integrate one acceleration reading over a long gap
+const WheelMicros REFERENCE_MAX_STEP_MICROS = 100000;
+
+class VehicleSpeedEstimator {
+
+private:
+
+  WheelMicros lastUpdateMicros;
+
+  // Latest CAN values, written by loop() and read by the wheel task
+  volatile float imuAccelerationMPHps;
+  volatile float gpsSpeedMPH;
+  volatile bool braking;
+
+  // Sorting network for the four wheel speeds, slowest first
+  static void sortFour(float *v) {
+    if (v[0] > v[1]) std::swap(v[0], v[1]);
+    if (v[2] > v[3]) std::swap(v[2], v[3]);
+    if (v[0] > v[2]) std::swap(v[0], v[2]);
+    if (v[1] > v[3]) std::swap(v[1], v[3]);
+    if (v[1] > v[2]) std::swap(v[1], v[2]);
+  }
+
+public:
+
+  float speedMPH;               // Fused reference speed
+  float wheelReferenceMPH;      // Wheel speed picked on the last update
+  bool wheelReferenceRejected;  // Wheel reference disagreed with the IMU on the last update
+
+  VehicleSpeedEstimator() {
+    lastUpdateMicros = 0;
+    imuAccelerationMPHps = 0;
+    gpsSpeedMPH = 0;
+    braking = false;
+    speedMPH = 0;
+    wheelReferenceMPH = 0;
+    wheelReferenceRejected = false;
+  }
+
+  // Call from loop() with the CAN variables
+  void setInputs(float accelerationX, int gpsVelocity, int brakePedalPercentage) {
+    imuAccelerationMPHps = accelerationX * IMU_ACCEL_TO_MPHPS;
+    gpsSpeedMPH = gpsVelocity * GPS_VELOCITY_TO_MPH;
+    braking = brakePedalPercentage > REFERENCE_BRAKING_PEDAL_PERCENT;
+  }
+
+  // Takes the four wheel speeds, all at now, and returns the new reference speed
+  float update(WheelMicros now, const float *wheelSpeedMPH) {
+    float sorted[4] = { wheelSpeedMPH[0], wheelSpeedMPH[1], wheelSpeedMPH[2], wheelSpeedMPH[3] };
+    sortFour(sorted);
+    wheelReferenceMPH = braking ? sorted[2] : sorted[1];
+
+    if (lastUpdateMicros == 0) {
+      lastUpdateMicros = now;
+      speedMPH = wheelReferenceMPH;
+      return speedMPH;
+    }
+
+    WheelMicros stepMicros = now - lastUpdateMicros;
+    lastUpdateMicros = now;
+    if (stepMicros > REFERENCE_MAX_STEP_MICROS) stepMicros = REFERENCE_MAX_STEP_MICROS;
+    float dt = stepMicros / 1000000.0;
+
+    // Predict with the IMU, then pull toward the wheels (or GPS) as a first-order filter
+    float predictedMPH = speedMPH + imuAccelerationMPHps * dt;
+    float innovation = wheelReferenceMPH - predictedMPH;
+    wheelReferenceRejected = fabsf(innovation) > REFERENCE_WHEEL_GATE_MPH;
+
+    if (!wheelReferenceRejected) {
+      predictedMPH += innovation * dt / (REFERENCE_WHEEL_TIME_CONSTANT + dt);
+    } else {
+      predictedMPH += innovation * dt / (REFERENCE_SLIP_TIME_CONSTANT + dt);
+      // gpsVelocity is 0 without a fix as well as when stopped, so only trust it while moving
+      float gps = gpsSpeedMPH;
+      if (gps > 0) {
+        predictedMPH += (gps - predictedMPH) * dt / (REFERENCE_GPS_TIME_CONSTANT + dt);
+      }
+    }
+
+    speedMPH = predictedMPH > 0 ? predictedMPH : 0;
+    return speedMPH;
+  }
+};
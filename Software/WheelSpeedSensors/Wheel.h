@@ -1,21 +1,164 @@
-const float wheelDiameter = 23;      // Diameter of our wheels in inches
+#include <Preferences.h>
+#include "esp_timer.h"
+#include "SpscRing.h"
+
+// Wheel timestamps are 64-bit microseconds since boot from esp_timer. They never wrap, so edges
+// logged hours apart can be ordered and subtracted directly; intervals are only narrowed to
+// unsigned long after they have been checked against ZERO_TIMEOUT_MICROS
+typedef int64_t WheelMicros;
+
+inline WheelMicros wheelMicros() {
+  return esp_timer_get_time();
+}
+
+// Vehicle profile: the rotor/tire configuration VehicleWheel (bottom of this file) is compiled for.
+// Wheel<> static_asserts that these combine into something the speed math can handle
+constexpr float wheelDiameter = 23;  // Diameter of our wheels in inches
 const int targetsPerRevolution = 4;  // number of sensing points per revolution on the wheel
-const float wheelSpinThreshold = 5;  // Speed difference (mph) above GPS vehicle velocity where we will declare wheelspin
-const float wheelSkidThreshold = 5;  // Speed difference (mph) below GPS vehicle velocity where we will declare skidding
+const int wheelAvgSamples = 3;       // RPM values box-averaged by the AVERAGE_INTERVALS estimator
+const float wheelSpinEnterSlip = 0.20;  // Slip ratio above which we declare wheelspin
+const float wheelSpinExitSlip = 0.10;   // ...and below which the wheel is back to GOOD
+const float wheelSkidEnterSlip = -0.20; // Slip ratio below which we declare skidding (-1 is fully locked)
+const float wheelSkidExitSlip = -0.10;  // ...and above which the wheel is back to GOOD
 
-const float rpmToMphFactor = wheelDiameter / 63360.0 * 3.1415 * 60.0;  // When wheel RPM is multiplied by this, it results in that wheel's linear speed in MPH
+constexpr float rpmToMphFactor = wheelDiameter / 63360.0 * 3.1415 * 60.0;  // When wheel RPM is multiplied by this, it results in that wheel's linear speed in MPH
 
-float vehicleSpeedMPH = 0;  // Since GPS velocity is given in m/s, this converts and stores to MPH
+float vehicleSpeedMPH = 0;  // Reference speed from VehicleSpeed.h, updated by WheelBank::update()
 
 // Minimum time between valid readings (microseconds) - prevents noise/bouncing
-// 5000us = 5ms = maximum 720 RPM (well above expected max)
-const unsigned long MIN_PULSE_INTERVAL = 5000;
+// This is only the floor of the debounce window: once a wheel is turning, the window
+// follows DEBOUNCE_PERIOD_FRACTION of its tooth period instead
+const unsigned long MIN_PULSE_INTERVAL = 1000;
+
+// Edges that arrive sooner than this fraction of the last tooth period after the previous
+// edge are treated as noise. It has to stay under 0.5: if the wheel accelerates hard enough
+// that a real edge gets filtered, the next accepted interval spans two teeth, and the window
+// computed from it must still be shorter than one real tooth or we would lock out every other edge
+constexpr float DEBOUNCE_PERIOD_FRACTION = 0.35;
+static_assert(DEBOUNCE_PERIOD_FRACTION < 0.5, "Debounce window must recover after filtering a real edge");
+const uint32_t DEBOUNCE_PERIOD_Q10 = uint32_t(DEBOUNCE_PERIOD_FRACTION * 1024 + 0.5f);
 
 // Maximum time to wait before declaring zero RPM
 // At 1 MPH with 4 targets, we get a pulse every ~1.03 seconds
 // Allow 2 seconds (2,000,000 microseconds) before declaring zero
+// Before that, an overdue edge already pulls the reported speed down (see checkZeroRPM())
 const unsigned long ZERO_TIMEOUT_MICROS = 2000000;
 
+// 650 RPM = ~45 MPH, reasonable maximum
+const int MAX_WHEEL_RPM = 650;
+
+// Number of edge timestamps that can be queued between the ISR and calculateRPM()
+// At ~45 MPH with 4 targets that is ~370ms of wheel task stall before an edge is dropped
+const unsigned int EDGE_QUEUE_SIZE = 16;
+
+// Default number of recent consecutive edge timestamps kept for the multi-tooth estimator
+// and tooth calibration (must be a power of two)
+const int DEFAULT_EDGE_WINDOW_SIZE = 16;
+
+// The multi-tooth estimator uses as many teeth as fit in this window (but always at least one)
+// At 45 MPH with 4 targets that is a full revolution; below ~10 MPH it is a single tooth
+const unsigned long MULTI_TOOTH_WINDOW_MICROS = 100000;
+
+// Per-tooth spacing calibration: the holes in the rotor are drilled by hand, so each hole-to-hole
+// angle is slightly off 360/targetsPerRevolution. While cruising we learn each interval's error
+// relative to the revolution it belongs to and divide it back out of the period.
+const float TOOTH_CAL_GAIN = 0.02;               // Fraction of each new observation blended into the table
+const unsigned long TOOTH_CAL_STEADY_DIVISOR = 100;  // Max revolution-to-revolution period change (1/100) to count as steady
+const unsigned long TOOTH_CAL_MAX_REV_MICROS = 1000000;  // Only learn above 60 RPM (~4 MPH)
+static_assert(uint64_t(TOOTH_CAL_MAX_REV_MICROS) * 2 * 2048 < 4294967296ULL, "Q11 tooth observation overflows 32 bits");
+const unsigned long TOOTH_CAL_SAVE_UPDATES = 400;        // Learning updates (~100 revolutions) before the table is worth saving
+
+// How calculateRPM() turns edge timestamps into a speed
+enum SpeedEstimator {
+  AVERAGE_INTERVALS,  // Box average of the last AVG_SAMPLES single-tooth RPM values
+  MULTI_TOOTH,        // N teeth divided by the time spanning N edges, N adapted to speed
+  ALPHA_BETA          // Alpha-beta tracker fed with every tooth interval, also gives acceleration
+};
+
+const SpeedEstimator defaultSpeedEstimator = ALPHA_BETA;
+
+// Alpha-beta speed/acceleration tracker. It always runs (so acceleration and prediction between
+// edges are available with any estimator) and is the reported speed when using ALPHA_BETA.
+// BETA follows the Benedict-Bordner relation beta = alpha^2 / (2 - alpha) for a well damped response
+constexpr float TRACKER_ALPHA = 0.4;
+constexpr float TRACKER_BETA = TRACKER_ALPHA * TRACKER_ALPHA / (2 - TRACKER_ALPHA);
+
+// The integer pipeline runs the same tracker in fixed point: speed in Q4 centi-MPH and acceleration
+// in Q4 centi-MPH per 2^TRACKER_ACCEL_TIME_BITS microseconds, so predicting is a multiply and a shift
+// and the only divides are the two 32-bit ones by the tooth interval
+const int TRACKER_ACCEL_TIME_BITS = 16;
+const int32_t TRACKER_ALPHA_Q10 = int32_t(TRACKER_ALPHA * 1024 + 0.5f);
+const int32_t TRACKER_BETA_Q16 = int32_t(TRACKER_BETA * 65536 + 0.5f);
+const int32_t TRACKER_MAX_RESIDUAL_Q4 = 1 << 18;  // ~160 MPH; keeps residual * TRACKER_BETA_Q16 in 32 bits
+static_assert(int64_t(TRACKER_MAX_RESIDUAL_Q4) * TRACKER_BETA_Q16 < 2147483648LL, "Tracker beta term overflows 32 bits");
+
+constexpr float mphToRpmFactor = 1.0 / rpmToMphFactor;
+const float MPH_TO_INCHES_PER_SEC = 63360.0 / 3600.0;
+
+// Integer speed pipeline: speed is produced in centi-MPH from one 32-bit multiply and divide
+// per update instead of the float divide/average/multiply chain. Angles are in Q10 teeth
+// (1024 = one nominal tooth spacing) so the per-tooth calibration still applies.
+// No edge does a float divide in this pipeline (the tracker, overdue bound, debounce window, jitter
+// and tooth calibration observations are all integer); the float work left per edge is scaling the
+// outputs and blending the tooth table. That is for the ESP32, whose FPU has no single divide
+// instruction while its 32-bit integer divide is one. It is no faster on a PC, which divides floats
+// in hardware faster than integers: test/WheelPipelineTest times the integer pipeline 10-20% slower
+// there. Only WheelBenchmark.h on the car can show what it saves.
+// Set false to fall back to the float pipeline (useful for comparing in WheelBenchmark.h)
+const bool defaultIntegerPipeline = true;
+
+const int TOOTH_ANGLE_ONE = 1024;  // Q10 angle of one nominal tooth spacing
+
+constexpr float centiMphToRpmFactor = 0.01 / rpmToMphFactor;
+constexpr float CENTI_MPH_Q4_TO_MPH = 0.01 / 16;
+constexpr float TRACKER_ACCEL_Q4_TO_MPHPS = CENTI_MPH_Q4_TO_MPH * 1000000.0 / (1L << TRACKER_ACCEL_TIME_BITS);
+
+// Speed extrapolated from the last edge to 'now' with the tracked acceleration, so anything
+// sampling between edges (like the CAN send loop) gets a current value. The horizon is capped at
+// one tooth period so a stale acceleration cannot run away while waiting for the next edge.
+// Once the next edge is overdue, the wheel cannot be turning faster than one (nextToothMPHMicros)
+// tooth per elapsed time. Shared by Wheel::predictSpeedMPH() and WheelBank's all-wheel pass
+inline float predictWheelSpeedMPH(WheelMicros now, WheelMicros lastEdgeMicros, WheelMicros nextExpectedMicros,
+                                  unsigned long toothMicros, float edgeSpeedMPH, float accelerationMPHps, float nextToothMPHMicros) {
+  WheelMicros sinceEdge = now - lastEdgeMicros;
+
+  if (now > nextExpectedMicros) {
+    float boundMPH = nextToothMPHMicros / float(sinceEdge);
+    return edgeSpeedMPH < boundMPH ? edgeSpeedMPH : boundMPH;
+  }
+
+  WheelMicros horizon = sinceEdge < WheelMicros(toothMicros) ? sinceEdge : WheelMicros(toothMicros);
+  float predictedMPH = edgeSpeedMPH + accelerationMPHps * horizon * 1e-6f;
+  return predictedMPH > 0 ? predictedMPH : 0;
+}
+
+// Fixed jitter histogram buckets: change of each tooth interval from the one before it (corrected for
+// hole spacing), in per-mille. Bucket i counts deviations below JITTER_BUCKET_LIMITS_PERMILLE[i] and the
+// last bucket everything at or above the final limit. A missed tooth lands near +1000, a double trigger near -500
+const int JITTER_BUCKET_COUNT = 12;
+const int32_t JITTER_BUCKET_LIMITS_PERMILLE[JITTER_BUCKET_COUNT - 1] = { -200, -50, -20, -10, -5, 0, 5, 10, 20, 50, 200 };
+
+// Pulse quality counters for one wheel sensor, all updated at O(1) cost per edge
+// The ISR-side counts (debounceRejects, droppedEdges) live on Wheel itself since they have to be volatile
+struct WheelDiagnostics {
+  unsigned long acceptedEdges;     // Intervals that produced a speed
+  unsigned long shortRejects;      // Intervals below the debounce floor that still reached processEdge()
+  unsigned long overRangeRejects;  // Intervals faster than MAX_WHEEL_RPM
+  unsigned long timeouts;          // ZERO_TIMEOUT_MICROS passed without an edge
+  unsigned long baselineResets;    // Edges spent re-establishing the baseline (after timeouts, drops, resyncs)
+  unsigned long jitterHistogram[JITTER_BUCKET_COUNT];
+};
+
+// Slip ratio is (wheel - vehicle) / vehicle, but below this vehicle speed it is taken against this instead,
+// so a wheel creeping at walking pace isn't 100% slip while one spinning up from a standstill still shows
+const float SLIP_MIN_REFERENCE_MPH = 5;
+
+// A new wheel state has to be seen continuously for WHEEL_STATE_ENTER_MICROS before it is reported,
+// and a reported state is held for at least WHEEL_STATE_MIN_DWELL_MICROS, so one noisy update can't
+// flip the state and a wheel bouncing across a threshold doesn't chatter on CAN
+const unsigned long WHEEL_STATE_ENTER_MICROS = 30000;
+const unsigned long WHEEL_STATE_MIN_DWELL_MICROS = 200000;
+
 enum WheelState {
   GOOD,
   SPIN,
@@ -23,219 +166,754 @@ enum WheelState {
 };
 
 // Class that defines shared variables and functions between the four wheels
+// Specialised at compile time on the number of targets, the averaging depth, the debounce interval
+// and the edge window size, so every per-tooth constant below folds into a literal and ring indices
+// wrap with a mask instead of a modulo
+template <int Targets, int AvgSamples, unsigned long MinPulseInterval = MIN_PULSE_INTERVAL, int EdgeWindow = DEFAULT_EDGE_WINDOW_SIZE>
 class Wheel {
 
 public:
 
+  static const int TARGETS = Targets;
+  static const int AVG_SAMPLES = AvgSamples;
+  static const int EDGE_WINDOW_SIZE = EdgeWindow;
+  static const unsigned int EDGE_WINDOW_MASK = EdgeWindow - 1;
+
+  // 650 RPM expressed as the shortest tooth interval so the check is an integer compare
+  static constexpr unsigned long MIN_TOOTH_INTERVAL_MICROS = 60000000UL / (MAX_WHEEL_RPM * Targets);
+
+  // Never span more than this many teeth, even if they fit in the window
+  static const int MULTI_TOOTH_MAX_TEETH = 2 * Targets;
+
+  // RPM * microseconds and MPH * microseconds for one nominal tooth spacing
+  static constexpr float RPM_TOOTH_MICROS = 60000000.0 / Targets;
+  static constexpr float MPH_TOOTH_MICROS = 60000000.0 / Targets * rpmToMphFactor;
+
+  // wheelDiameter, pi, 63360 in/mi, 60 s/min, 1e6 us/s, Targets and the Q10 scale all folded
+  // into one constant: centi-MPH = CENTI_MPH_ANGLE_MICROS * angleQ10 / microseconds
+  static constexpr uint32_t CENTI_MPH_ANGLE_MICROS = uint32_t(100.0 * 60000000.0 / Targets * rpmToMphFactor / TOOTH_ANGLE_ONE + 0.5);
+
+  static_assert(Targets >= 1, "Need at least one target per revolution");
+  static_assert(AvgSamples >= 1, "Need at least one sample to average");
+  static_assert(EdgeWindow > 0 && (EdgeWindow & (EdgeWindow - 1)) == 0, "Edge window must be a power of two");
+  static_assert(EdgeWindow > 2 * Targets, "Tooth calibration needs two full revolutions of edges in the window");
+  static_assert(EdgeWindow > MULTI_TOOTH_MAX_TEETH, "Multi-tooth estimator needs MULTI_TOOTH_MAX_TEETH + 1 edges in the window");
+  static_assert(MinPulseInterval < MIN_TOOTH_INTERVAL_MICROS, "Debounce interval would reject real edges below MAX_WHEEL_RPM");
+  static_assert(uint64_t(CENTI_MPH_ANGLE_MICROS) * (MULTI_TOOTH_MAX_TEETH + 1) * TOOTH_ANGLE_ONE + ZERO_TIMEOUT_MICROS < 4294967296ULL, "CENTI_MPH_ANGLE_MICROS * angle overflows 32 bits");
+  // The tracker's measurement in Q4, for any hole less than twice the nominal spacing
+  static_assert(uint64_t(CENTI_MPH_ANGLE_MICROS) * 2 * TOOTH_ANGLE_ONE * 16 + ZERO_TIMEOUT_MICROS < 4294967296ULL, "Q4 tooth speed overflows 32 bits");
+
   int sensorPin;  // GPIO that sensor is hooked up to
 
-  volatile unsigned long lastReadingMicros;
-  volatile unsigned long currentReadingMicros;
-  volatile bool updateFlag;
+  SpscRing<WheelMicros, EDGE_QUEUE_SIZE> edgeQueue;  // Edge timestamps pushed by the ISR, drained by calculateRPM()
+  volatile WheelMicros lastEdgeMicros;    // Last edge accepted by the ISR (ISR-owned, used for debouncing)
+  volatile unsigned long debounceMicros;  // Current glitch filter window (written by processEdge(), read by the ISR)
+  volatile unsigned long droppedEdges;    // Edges the ISR could not queue because processing fell behind
+  volatile unsigned long debounceRejects; // Edges the ISR filtered as noise
+  unsigned long seenDroppedEdges;         // droppedEdges value as of the last drain
 
-  unsigned long nextExpectedMicros;
+  WheelMicros lastReadingMicros;   // Last edge processed by calculateRPM()
+  WheelMicros nextExpectedMicros;  // When the next edge is due at the current speed
   
   float rpm;  // variable to store calculated RPM value
   float wheelSpeedMPH;  // calculated wheel velocity for comparison with GPS vehicle velocity
+  uint32_t wheelSpeedCentiMPH;  // Same speed in hundredths of an MPH (integer pipeline only)
+  float wheelAccelerationMPHps;  // Tracked linear acceleration of the wheel surface (MPH per second)
+  // Effective rolling diameter / wheelDiameter, learned by TireCalibration.h. Speeds inside Wheel
+  // stay nominal; WheelBank scales the ones it publishes
+  float tireScale;
+  unsigned long lastToothMicros; // Most recent accepted tooth interval
+
+  // Alpha-beta tracker state, valid at trackerMicros (the middle of the last tooth interval)
+  float trackedSpeedMPH;
+  int32_t trackedCentiMphQ4;  // Fixed-point tracker state (integer pipeline), see TRACKER_ACCEL_TIME_BITS
+  int32_t trackedAccelQ4;
+  WheelMicros trackerMicros;
+  bool trackerInitialized;
 
   bool ignoreNextReading;
   bool isFirstReading;
 
-  WheelState wheelState;
+  WheelState wheelState;         // Debounced state, see checkWheelState()
+  float slipRatio;               // Signed slip against vehicleSpeedMPH from the last checkWheelState()
+  WheelState pendingState;       // State the slip ratio currently points to
+  WheelMicros pendingSinceMicros;
+  WheelMicros stateSinceMicros;  // When wheelState last changed
+
+  SpeedEstimator speedEstimator;  // Can be changed per wheel after construction
+  bool integerPipeline;           // Can be changed per wheel after construction
+
+  // Recent consecutive edges for the multi-tooth estimator (cleared whenever the baseline is re-established)
+  WheelMicros edgeHistory[EDGE_WINDOW_SIZE];
+  int edgeHistoryIndex;  // Slot the next edge will be written to
+  int edgeHistoryCount;
+
+  // Learned spacing error of the interval ending on each tooth, as a fraction of the nominal spacing
+  // (sums to zero). Tooth numbering is relative to wherever we started counting, so after losing
+  // the baseline the phase has to be re-acquired by matching observed errors against the table
+  float toothError[TARGETS];
+  int16_t toothErrorQ10[TARGETS];  // toothError in Q10 teeth for the integer pipeline
+  int toothIndex;                // Tooth the newest edge in edgeHistory ended on
+  bool toothPhaseLocked;         // toothIndex lines up with toothError
+  unsigned long toothCalUpdates; // Learning updates since the table was created (0 = nothing learned)
+  unsigned long toothCalUpdatesAtSave;
+  bool persistToothCalibration;  // Let WheelBank save the table to NVS once the car stops (off for replayed/benchmark wheels)
+  float phaseObservations[TARGETS];  // Observed errors while re-acquiring phase
+  int phaseObservationCount;
+
+  WheelDiagnostics diagnostics;  // Written by the processing task; fine to read from anywhere for reporting
 
   // Moving average for stability
-  static const int AVG_SAMPLES = 3;
   float rpmHistory[AVG_SAMPLES];
+  uint32_t centiMphHistory[AVG_SAMPLES];  // Integer pipeline equivalent of rpmHistory
+  uint32_t centiMphHistorySum;             // Running sum so averaging needs no loop
   int rpmHistoryIndex;
   int rpmHistoryCount;  // Track how many samples we have
 
   Wheel(int pinNumber) {
     sensorPin = pinNumber;
-    unsigned long currentTime = micros();
+    WheelMicros currentTime = wheelMicros();
+    lastEdgeMicros = currentTime;
+    debounceMicros = MinPulseInterval;
+    droppedEdges = 0;
+    debounceRejects = 0;
+    seenDroppedEdges = 0;
+    memset(&diagnostics, 0, sizeof(diagnostics));
     lastReadingMicros = currentTime;
-    currentReadingMicros = currentTime;
     nextExpectedMicros = currentTime + ZERO_TIMEOUT_MICROS;
     rpm = 0;
     wheelSpeedMPH = 0;
-    updateFlag = false;
+    wheelSpeedCentiMPH = 0;
+    wheelAccelerationMPHps = 0;
+    tireScale = 1.0;
+    lastToothMicros = ZERO_TIMEOUT_MICROS;
+    trackedSpeedMPH = 0;
+    trackedCentiMphQ4 = 0;
+    trackedAccelQ4 = 0;
+    trackerMicros = currentTime;
+    trackerInitialized = false;
     ignoreNextReading = false;
     isFirstReading = true;
     wheelState = GOOD;
+    slipRatio = 0;
+    pendingState = GOOD;
+    pendingSinceMicros = currentTime;
+    stateSinceMicros = currentTime;
+    speedEstimator = defaultSpeedEstimator;
+    integerPipeline = defaultIntegerPipeline;
+    edgeHistoryIndex = 0;
+    edgeHistoryCount = 0;
+    toothIndex = 0;
+    toothPhaseLocked = true;
+    toothCalUpdates = 0;
+    toothCalUpdatesAtSave = 0;
+    persistToothCalibration = true;
+    phaseObservationCount = 0;
+    for (int i = 0; i < TARGETS; i++) {
+      toothError[i] = 0;
+      toothErrorQ10[i] = 0;
+    }
     rpmHistoryIndex = 0;
     rpmHistoryCount = 0;
+    centiMphHistorySum = 0;
 
     // Initialize RPM history to zero
     for(int i = 0; i < AVG_SAMPLES; i++) {
       rpmHistory[i] = 0;
+      centiMphHistory[i] = 0;
     }
 
     pinMode(sensorPin, INPUT);
   }
 
-  // Calculates RPM based on elapsed time between last reading and current time
-  // Only runs after respective ISR is triggered
+  // Drains every edge the ISR has queued since the last call and runs each through processEdge()
+  // Only does work after the respective ISR has fired
   void calculateRPM() {
-    if (!updateFlag) return;
+    WheelMicros edgeMicros;
+    while (edgeQueue.pop(edgeMicros)) {
+      processEdge(edgeMicros);
+    }
 
-    // Capture timing variables atomically to avoid race conditions
-    noInterrupts();
-    unsigned long capturedCurrent = currentReadingMicros;
-    unsigned long capturedLast = lastReadingMicros;
-    updateFlag = false;
-    interrupts();
+    // If the queue overflowed, the next edge is more than one tooth after the last one we saw
+    unsigned long dropped = droppedEdges;
+    if (dropped != seenDroppedEdges) {
+      seenDroppedEdges = dropped;
+      ignoreNextReading = true;
+    }
+  }
 
+  // Calculates RPM based on elapsed time between the previous edge and this one
+  void processEdge(WheelMicros edgeMicros) {
     // Skip first reading - need two points to calculate speed
     if (isFirstReading) {
-      noInterrupts();
-      lastReadingMicros = capturedCurrent;
-      interrupts();
+      restartEdgeHistory(edgeMicros);
+      lastReadingMicros = edgeMicros;
       isFirstReading = false;
-      nextExpectedMicros = capturedCurrent + ZERO_TIMEOUT_MICROS;
+      nextExpectedMicros = edgeMicros + ZERO_TIMEOUT_MICROS;
       return;
     }
 
     // If we just recovered from zero, ignore this reading (re-establish baseline)
     if (ignoreNextReading) {
-      noInterrupts();
-      lastReadingMicros = capturedCurrent;
-      interrupts();
+      diagnostics.baselineResets++;
+      restartEdgeHistory(edgeMicros);
+      lastReadingMicros = edgeMicros;
       ignoreNextReading = false;
-      nextExpectedMicros = capturedCurrent + ZERO_TIMEOUT_MICROS;
+      nextExpectedMicros = edgeMicros + ZERO_TIMEOUT_MICROS;
       return;
     }
 
-    // Calculate time difference (handles overflow correctly since both are unsigned long)
-    unsigned long timeDifference = capturedCurrent - capturedLast;
+    WheelMicros elapsed = edgeMicros - lastReadingMicros;
     
     // Sanity check: reject readings that are too fast (noise/bounce filter)
-    if (timeDifference < MIN_PULSE_INTERVAL) {
+    if (elapsed < WheelMicros(MinPulseInterval)) {
+      diagnostics.shortRejects++;
       return;
     }
     
     // Sanity check: reject readings that are impossibly slow (missed timeout somehow)
-    if (timeDifference > ZERO_TIMEOUT_MICROS) {
-      noInterrupts();
-      lastReadingMicros = capturedCurrent;
-      interrupts();
+    if (elapsed > WheelMicros(ZERO_TIMEOUT_MICROS)) {
+      lastReadingMicros = edgeMicros;
       ignoreNextReading = true;
       return;
     }
-    
-    // Calculate RPM from time difference
-    float instantRPM = (1.00 / (float(timeDifference) / 1000000.0)) * 60.0 / targetsPerRevolution;
+
+    // Bounded by ZERO_TIMEOUT_MICROS from here on, so 32 bits are plenty
+    unsigned long timeDifference = (unsigned long)elapsed;
     
     // Sanity check: 650 RPM = ~45 MPH, reasonable maximum
-    if (instantRPM > 650) {
-      Serial.print("RPM over 650 rejected: ");
-      Serial.print(instantRPM);
-      Serial.print(" on pin ");
-      Serial.println(sensorPin);
+    // Counted rather than printed so a noisy sensor can't stall processing on Serial
+    if (timeDifference < MIN_TOOTH_INTERVAL_MICROS) {
+      diagnostics.overRangeRejects++;
       return;
     }
     
-    // Add to moving average buffer
-    rpmHistory[rpmHistoryIndex] = instantRPM;
-    rpmHistoryIndex = (rpmHistoryIndex + 1) % AVG_SAMPLES;
-    if (rpmHistoryCount < AVG_SAMPLES) {
-      rpmHistoryCount++;
+    addEdgeToHistory(edgeMicros);
+    diagnostics.acceptedEdges++;
+    recordJitter(timeDifference);
+    updateToothCalibration();
+    if (integerPipeline) {
+      updateSpeedTrackerInteger(edgeMicros, timeDifference);
+    } else {
+      updateSpeedTracker(edgeMicros, timeDifference);
+    }
+    lastToothMicros = timeDifference;
+    lastReadingMicros = edgeMicros;
+
+    if (integerPipeline) {
+      updateSpeedInteger(timeDifference);
+    } else {
+      updateSpeedFloat(timeDifference);
     }
     
-    // Calculate average RPM
-    float sum = 0;
-    for(int i = 0; i < rpmHistoryCount; i++) {
-      sum += rpmHistory[i];
+    // The next edge is due one tooth period from now; past that, checkZeroRPM() starts decaying the speed
+    nextExpectedMicros = edgeMicros + timeDifference;
+
+    // Anything in the first part of the next period can't be a real tooth at any plausible acceleration
+    unsigned long window = (timeDifference * DEBOUNCE_PERIOD_Q10) >> 10;
+    debounceMicros = (window > MinPulseInterval) ? window : MinPulseInterval;
+  }
+
+  void updateSpeedFloat(unsigned long timeDifference) {
+    if (speedEstimator == MULTI_TOOTH) {
+      rpm = multiToothRPM();
+    } else if (speedEstimator == ALPHA_BETA) {
+      rpm = trackedSpeedAt(lastReadingMicros) * mphToRpmFactor;
+    } else {
+      // Calculate RPM from time difference
+      float instantRPM = RPM_TOOTH_MICROS / float(timeDifference);
+
+      // Correct for the actual angle between this hole and the previous one
+      instantRPM *= toothSpacing(0);
+
+      // Add to moving average buffer
+      rpmHistory[rpmHistoryIndex] = instantRPM;
+      rpmHistoryIndex++;
+      if (rpmHistoryIndex == AVG_SAMPLES) {
+        rpmHistoryIndex = 0;
+      }
+      if (rpmHistoryCount < AVG_SAMPLES) {
+        rpmHistoryCount++;
+      }
+      
+      // Calculate average RPM
+      float sum = 0;
+      for(int i = 0; i < rpmHistoryCount; i++) {
+        sum += rpmHistory[i];
+      }
+      rpm = sum / rpmHistoryCount;
     }
-    rpm = sum / rpmHistoryCount;
     
     // Convert to MPH
     wheelSpeedMPH = rpm * rpmToMphFactor;
-    
-    // Update timing for next expected reading (with 2x buffer for timeout detection)
-    nextExpectedMicros = capturedCurrent + (timeDifference * 2);
-    
-    // Update last reading time atomically
-    noInterrupts();
-    lastReadingMicros = capturedCurrent;
-    interrupts();
+  }
+
+  void updateSpeedInteger(unsigned long timeDifference) {
+    uint32_t centiMPH;
+    if (speedEstimator == MULTI_TOOTH) {
+      centiMPH = multiToothCentiMPH();
+    } else if (speedEstimator == ALPHA_BETA) {
+      int32_t trackedQ4 = trackedCentiMphQ4At(lastReadingMicros);
+      centiMPH = trackedQ4 > 0 ? uint32_t(trackedQ4 + 8) >> 4 : 0;
+    } else {
+      uint32_t instantCentiMPH = (CENTI_MPH_ANGLE_MICROS * toothAngleQ10(0) + timeDifference / 2) / timeDifference;
+
+      // Swap the oldest sample out of the running sum
+      centiMphHistorySum += instantCentiMPH - centiMphHistory[rpmHistoryIndex];
+      centiMphHistory[rpmHistoryIndex] = instantCentiMPH;
+      rpmHistoryIndex++;
+      if (rpmHistoryIndex == AVG_SAMPLES) {
+        rpmHistoryIndex = 0;
+      }
+      if (rpmHistoryCount < AVG_SAMPLES) {
+        rpmHistoryCount++;
+      }
+      centiMPH = centiMphHistorySum / rpmHistoryCount;
+    }
+
+    wheelSpeedCentiMPH = centiMPH;
+    wheelSpeedMPH = centiMPH * 0.01f;
+    rpm = centiMPH * centiMphToRpmFactor;
+  }
+
+  // Blends the speed measured over the newest tooth interval into the tracked speed and acceleration
+  void updateSpeedTracker(WheelMicros edgeMicros, unsigned long timeDifference) {
+    float measuredMPH = toothSpacing(0) * MPH_TOOTH_MICROS / float(timeDifference);
+
+    // One interval measures the average speed across it, which is the speed at its midpoint
+    WheelMicros measurementMicros = edgeMicros - timeDifference / 2;
+
+    if (!trackerInitialized) {
+      trackedSpeedMPH = measuredMPH;
+      wheelAccelerationMPHps = 0;
+      trackerMicros = measurementMicros;
+      trackerInitialized = true;
+      return;
+    }
+
+    float dt = (measurementMicros - trackerMicros) * 1e-6f;
+    float predictedMPH = trackedSpeedMPH + wheelAccelerationMPHps * dt;
+    float residual = measuredMPH - predictedMPH;
+    trackedSpeedMPH = predictedMPH + TRACKER_ALPHA * residual;
+    wheelAccelerationMPHps += TRACKER_BETA * residual / dt;
+    trackerMicros = measurementMicros;
+  }
+
+  float trackedSpeedAt(WheelMicros atMicros) {
+    return trackedSpeedMPH + wheelAccelerationMPHps * float(atMicros - trackerMicros) * 1e-6f;
+  }
+
+  // updateSpeedTracker() in fixed point for the integer pipeline. The float outputs it keeps up to
+  // date (trackedSpeedMPH, wheelAccelerationMPHps) are only scaled, never divided
+  void updateSpeedTrackerInteger(WheelMicros edgeMicros, unsigned long timeDifference) {
+    int32_t measuredQ4 = int32_t((CENTI_MPH_ANGLE_MICROS * toothAngleQ10(0) * 16 + timeDifference / 2) / timeDifference);
+    WheelMicros measurementMicros = edgeMicros - timeDifference / 2;
+
+    if (!trackerInitialized) {
+      trackedCentiMphQ4 = measuredQ4;
+      trackedAccelQ4 = 0;
+      trackerMicros = measurementMicros;
+      trackerInitialized = true;
+    } else {
+      // Midpoint to midpoint is under two tooth intervals, so well inside 32 bits
+      int32_t dt = int32_t(measurementMicros - trackerMicros);
+      int32_t predictedQ4 = trackedCentiMphQ4At(measurementMicros);
+      int32_t residual = measuredQ4 - predictedQ4;
+      if (residual > TRACKER_MAX_RESIDUAL_Q4) residual = TRACKER_MAX_RESIDUAL_Q4;
+      if (residual < -TRACKER_MAX_RESIDUAL_Q4) residual = -TRACKER_MAX_RESIDUAL_Q4;
+      trackedCentiMphQ4 = predictedQ4 + ((residual * TRACKER_ALPHA_Q10 + 512) >> 10);
+      trackedAccelQ4 += residual * TRACKER_BETA_Q16 / dt;
+      trackerMicros = measurementMicros;
+    }
+
+    trackedSpeedMPH = trackedCentiMphQ4 * CENTI_MPH_Q4_TO_MPH;
+    wheelAccelerationMPHps = trackedAccelQ4 * TRACKER_ACCEL_Q4_TO_MPHPS;
+  }
+
+  int32_t trackedCentiMphQ4At(WheelMicros atMicros) {
+    return trackedCentiMphQ4 + int32_t((int64_t(trackedAccelQ4) * int32_t(atMicros - trackerMicros)) >> TRACKER_ACCEL_TIME_BITS);
+  }
+
+  // Current speed between edges (see predictWheelSpeedMPH())
+  float predictSpeedMPH(WheelMicros now) {
+    if (!hasSpeedEstimate()) return wheelSpeedMPH;
+    return predictWheelSpeedMPH(now, lastReadingMicros, nextExpectedMicros, lastToothMicros,
+                                wheelSpeedMPH, wheelAccelerationMPHps, nextToothMPHMicros());
+  }
+
+  // False until two edges have been seen since the last baseline reset
+  bool hasSpeedEstimate() {
+    return !isFirstReading && !ignoreNextReading && trackerInitialized;
+  }
+
+  // Numerator of the overdue speed bound: MPH * microseconds for the tooth we are waiting on
+  float nextToothMPHMicros() {
+    return toothSpacing(-1) * MPH_TOOTH_MICROS;
+  }
+
+  bool isEdgeOverdue(WheelMicros now) {
+    return now > nextExpectedMicros;
+  }
+
+  // If the wheel were turning any faster than this, the next tooth would already have arrived
+  float overdueBoundMPH(WheelMicros now) {
+    return nextToothMPHMicros() / float(now - lastReadingMicros);
+  }
+
+  // Same bound for the integer pipeline; only valid before the zero timeout, so the time fits 32 bits
+  uint32_t overdueBoundCentiMPH(WheelMicros now) {
+    return CENTI_MPH_ANGLE_MICROS * toothAngleQ10(-1) / uint32_t(now - lastReadingMicros);
+  }
+
+  float angularAccelerationRadPerSec2() {
+    return wheelAccelerationMPHps * MPH_TO_INCHES_PER_SEC / (wheelDiameter / 2);
+  }
+
+  // Adds this interval's deviation from the previous one to the jitter histogram
+  void recordJitter(unsigned long timeDifference) {
+    if (edgeHistoryCount < 3) return;  // Need two consecutive intervals
+
+    // Previous interval scaled to this tooth's spacing, so a badly drilled hole doesn't look like jitter
+    // Both intervals are under ZERO_TIMEOUT_MICROS, so this all stays in 32 bits
+    int32_t expected = int32_t(uint32_t(lastToothMicros) * toothAngleQ10(0) / toothAngleQ10(1));
+    if (expected <= 0) return;
+
+    // Anything past +-25% lands in an end bucket anyway; clamping first keeps the permille in 32 bits
+    int32_t deviation = int32_t(timeDifference) - expected;
+    if (deviation > expected / 4) deviation = expected / 4;
+    if (deviation < -expected / 4) deviation = -expected / 4;
+    int32_t deviationPermille = deviation * 1000 / expected;
+
+    int bucket = 0;
+    while (bucket < JITTER_BUCKET_COUNT - 1 && deviationPermille >= JITTER_BUCKET_LIMITS_PERMILLE[bucket]) {
+      bucket++;
+    }
+    diagnostics.jitterHistogram[bucket]++;
+  }
+
+  // Starts a new run of consecutive edges with this one as the only entry
+  // We no longer know which hole this is, so the tooth table has to find its phase again
+  void restartEdgeHistory(WheelMicros edgeMicros) {
+    edgeHistoryCount = 0;
+    toothIndex = 0;
+    toothPhaseLocked = (toothCalUpdates == 0);  // Nothing learned yet, so any numbering will do
+    phaseObservationCount = 0;
+    trackerInitialized = false;
+    debounceMicros = MinPulseInterval;  // No period to go on yet
+    addEdgeToHistory(edgeMicros);
+  }
+
+  void addEdgeToHistory(WheelMicros edgeMicros) {
+    if (edgeHistoryCount > 0) {
+      toothIndex++;
+      if (toothIndex == TARGETS) {
+        toothIndex = 0;
+      }
+    }
+    edgeHistory[edgeHistoryIndex] = edgeMicros;
+    edgeHistoryIndex = (edgeHistoryIndex + 1) & EDGE_WINDOW_MASK;
+    if (edgeHistoryCount < EDGE_WINDOW_SIZE) {
+      edgeHistoryCount++;
+    }
+  }
+
+  // Timestamp of the edge 'teethBack' teeth before the newest one (0 = newest)
+  WheelMicros edgeBefore(int teethBack) {
+    return edgeHistory[(edgeHistoryIndex - 1 - teethBack) & EDGE_WINDOW_MASK];
+  }
+
+  // RPM from N teeth over the time spanning N edges. This averages in the time domain, so unlike
+  // averaging single-interval RPMs it is not biased high by the mean of reciprocals.
+  // N grows until the span would exceed MULTI_TOOTH_WINDOW_MICROS, so low speed uses one tooth
+  // (responsive) and high speed averages over more teeth (better resolution)
+  float multiToothRPM() {
+    unsigned long span;
+    int teeth = multiToothSpan(span);
+
+    float angle = 0;  // Angle covered by the span, in nominal tooth spacings
+    for (int i = 0; i < teeth; i++) {
+      angle += toothSpacing(i);
+    }
+
+    return angle * RPM_TOOTH_MICROS / float(span);
+  }
+
+  // Integer pipeline version of multiToothRPM()
+  uint32_t multiToothCentiMPH() {
+    unsigned long span;
+    int teeth = multiToothSpan(span);
+
+    uint32_t angle = 0;
+    for (int i = 0; i < teeth; i++) {
+      angle += toothAngleQ10(i);
+    }
+
+    return (CENTI_MPH_ANGLE_MICROS * angle + span / 2) / span;
+  }
+
+  // Picks how many teeth the multi-tooth estimator spans and returns the time they took in 'span'
+  int multiToothSpan(unsigned long &span) {
+    WheelMicros newest = edgeBefore(0);
+    int maxTeeth = edgeHistoryCount - 1;
+    if (maxTeeth > MULTI_TOOTH_MAX_TEETH) {
+      maxTeeth = MULTI_TOOTH_MAX_TEETH;
+    }
+
+    int teeth = 1;
+    span = (unsigned long)(newest - edgeBefore(1));
+    while (teeth < maxTeeth) {
+      unsigned long longerSpan = (unsigned long)(newest - edgeBefore(teeth + 1));
+      if (longerSpan > MULTI_TOOTH_WINDOW_MICROS) break;
+      teeth++;
+      span = longerSpan;
+    }
+    return teeth;
+  }
+
+  // Actual angle of the interval ending 'teethBack' teeth before the newest edge, in nominal spacings
+  float toothSpacing(int teethBack) {
+    if (!toothPhaseLocked) return 1.0;
+    return 1.0 + toothError[toothSlot(teethBack)];
+  }
+
+  // Same as toothSpacing() in Q10 teeth for the integer pipeline
+  uint32_t toothAngleQ10(int teethBack) {
+    if (!toothPhaseLocked) return TOOTH_ANGLE_ONE;
+    return TOOTH_ANGLE_ONE + toothErrorQ10[toothSlot(teethBack)];
+  }
+
+  // Table slot of the tooth 'teethBack' before the newest; unsigned so a power-of-two TARGETS wraps with a mask
+  unsigned int toothSlot(int teethBack) {
+    return unsigned(toothIndex - teethBack + TARGETS * EDGE_WINDOW_SIZE) % TARGETS;
+  }
+
+  void updateToothErrorQ10() {
+    for (int i = 0; i < TARGETS; i++) {
+      toothErrorQ10[i] = int16_t(lroundf(toothError[i] * TOOTH_ANGLE_ONE));
+    }
+  }
+
+  // Compares the newest interval with the revolution that ends on it. At steady speed every interval
+  // should be exactly 1/TARGETS of that, so the difference is the hole spacing error
+  void updateToothCalibration() {
+    if (edgeHistoryCount <= 2 * TARGETS) return;
+
+    // Every interval in the history is under ZERO_TIMEOUT_MICROS, so whole revolutions fit in 32 bits
+    WheelMicros newest = edgeBefore(0);
+    unsigned long revolution = (unsigned long)(newest - edgeBefore(TARGETS));
+    unsigned long previousRevolution = (unsigned long)(edgeBefore(TARGETS) - edgeBefore(2 * TARGETS));
+    if (revolution > TOOTH_CAL_MAX_REV_MICROS) return;
+
+    unsigned long revolutionChange = revolution > previousRevolution ? revolution - previousRevolution : previousRevolution - revolution;
+    if (revolutionChange * TOOTH_CAL_STEADY_DIVISOR > revolution) {
+      phaseObservationCount = 0;  // Phase matching needs a full steady revolution
+      return;
+    }
+
+    // Observed angle in Q11 teeth; a steady interval spanning more than two nominal teeth isn't a hole error
+    uint32_t interval = uint32_t(newest - edgeBefore(1));
+    if (interval * TARGETS > 2 * revolution) return;
+    uint32_t observedQ11 = ((interval * TARGETS << 11) + revolution / 2) / revolution;
+    float observedError = (int32_t(observedQ11) - 2048) * (1.0f / 2048);
+
+    if (!toothPhaseLocked) {
+      phaseObservations[toothIndex] = observedError;
+      phaseObservationCount++;
+      if (phaseObservationCount >= TARGETS) {
+        acquireToothPhase();
+      }
+      return;
+    }
+
+    toothError[toothIndex] += TOOTH_CAL_GAIN * (observedError - toothError[toothIndex]);
+    toothCalUpdates++;
+
+    // Keep the table zero-mean so it only redistributes angle within a revolution
+    float mean = 0;
+    for (int i = 0; i < TARGETS; i++) {
+      mean += toothError[i];
+    }
+    mean /= TARGETS;
+    for (int i = 0; i < TARGETS; i++) {
+      toothError[i] -= mean;
+    }
+    updateToothErrorQ10();
+  }
+
+  // Finds the rotation of our current tooth numbering that best matches the learned table
+  void acquireToothPhase() {
+    int bestShift = 0;
+    float bestCost = 0;
+    for (int shift = 0; shift < TARGETS; shift++) {
+      float cost = 0;
+      for (int i = 0; i < TARGETS; i++) {
+        float difference = phaseObservations[i] - toothError[(i + shift) % TARGETS];
+        cost += difference * difference;
+      }
+      if (shift == 0 || cost < bestCost) {
+        bestCost = cost;
+        bestShift = shift;
+      }
+    }
+    toothIndex = (toothIndex + bestShift) % TARGETS;
+    toothPhaseLocked = true;
+    phaseObservationCount = 0;
+  }
+
+  // Restores the tooth table saved by saveToothCalibration(). Call from setup() (NVS is not ready
+  // when the global Wheel objects are constructed)
+  void loadToothCalibration() {
+    Preferences preferences;
+    char key[16];
+    snprintf(key, sizeof(key), "tooth%d", sensorPin);
+    preferences.begin("wheelcal", true);
+    if (preferences.getBytesLength(key) == sizeof(toothError)) {
+      preferences.getBytes(key, toothError, sizeof(toothError));
+      updateToothErrorQ10();
+      toothCalUpdates = TOOTH_CAL_SAVE_UPDATES;
+      toothCalUpdatesAtSave = toothCalUpdates;
+      toothPhaseLocked = false;
+      phaseObservationCount = 0;
+    }
+    preferences.end();
+  }
+
+  // True once the table has learned enough since it was last saved to be worth a flash write
+  bool toothCalibrationUnsaved() {
+    return persistToothCalibration && toothCalUpdates - toothCalUpdatesAtSave >= TOOTH_CAL_SAVE_UPDATES;
+  }
+
+  // Writes to flash, which stalls both cores; only call with every wheel stopped (WheelBank::update() does)
+  void saveToothCalibration() {
+    Preferences preferences;
+    char key[16];
+    snprintf(key, sizeof(key), "tooth%d", sensorPin);
+    preferences.begin("wheelcal", false);
+    preferences.putBytes(key, toothError, sizeof(toothError));
+    preferences.end();
+    toothCalUpdatesAtSave = toothCalUpdates;
   }
 
   // Checks to see if a certain period of time has passed since last reading
-  // If we surpass that threshold, set the RPM to zero
+  // Once the next edge is overdue the speed decays as 1 tooth / elapsed time, and past
+  // ZERO_TIMEOUT_MICROS we set the RPM to zero and wait for a new baseline
   void checkZeroRPM() {
+    checkZeroRPM(wheelMicros());
+  }
+
+  // currentTime must be sampled after calculateRPM() so no processed edge is newer than it
+  void checkZeroRPM(WheelMicros currentTime) {
     // Don't check if we haven't established baseline yet
     if (isFirstReading || ignoreNextReading) return;
     
-    unsigned long currentTime = micros();
-    
     // Check if we've exceeded the expected next reading time
-    // This handles overflow correctly: if currentTime wraps around,
-    // the subtraction still works due to unsigned arithmetic properties
-    unsigned long timeSinceLastReading = currentTime - lastReadingMicros;
+    WheelMicros timeSinceLastReading = currentTime - lastReadingMicros;
     
-    if (timeSinceLastReading > ZERO_TIMEOUT_MICROS) {
+    if (timeSinceLastReading > WheelMicros(ZERO_TIMEOUT_MICROS)) {
       // No readings in too long - wheel has stopped
-      
-      // Reset all state atomically
-      noInterrupts();
+      diagnostics.timeouts++;
       lastReadingMicros = currentTime;
-      interrupts();
       
       ignoreNextReading = true;  // Next reading will be used to re-establish baseline
       rpm = 0;
       wheelSpeedMPH = 0;
+      wheelSpeedCentiMPH = 0;
+      wheelAccelerationMPHps = 0;
+      trackedSpeedMPH = 0;
+      trackedCentiMphQ4 = 0;
+      trackedAccelQ4 = 0;
       nextExpectedMicros = currentTime + ZERO_TIMEOUT_MICROS;
+      debounceMicros = MinPulseInterval;
       
+      edgeHistoryCount = 0;
+
       // Clear RPM history
       for(int i = 0; i < AVG_SAMPLES; i++) {
         rpmHistory[i] = 0;
+        centiMphHistory[i] = 0;
       }
+      centiMphHistorySum = 0;
       rpmHistoryIndex = 0;
       rpmHistoryCount = 0;
+    } else if (isEdgeOverdue(currentTime)) {
+      // A locked wheel shows up immediately instead of holding its last speed for 2 seconds
+      if (integerPipeline) {
+        uint32_t boundCentiMPH = overdueBoundCentiMPH(currentTime);
+        if (wheelSpeedCentiMPH > boundCentiMPH) {
+          wheelSpeedCentiMPH = boundCentiMPH;
+          wheelSpeedMPH = boundCentiMPH * 0.01f;
+          rpm = boundCentiMPH * centiMphToRpmFactor;
+        }
+        return;
+      }
+      float boundMPH = overdueBoundMPH(currentTime);
+      if (wheelSpeedMPH > boundMPH) {
+        wheelSpeedMPH = boundMPH;
+        wheelSpeedCentiMPH = uint32_t(boundMPH * 100);
+        rpm = boundMPH * mphToRpmFactor;
+      }
     }
   }
 
-  // Compares wheel speed to GPS vehicle speed to see if we have wheelspin or skidding
-  void checkWheelState() {
-    // Only check wheel state if we have valid GPS data
-    if (vehicleSpeedMPH < 0.1) {
-      wheelState = GOOD;  // Don't declare spin/skid at very low speeds
-      return;
+  // Compares wheel speed to the vehicle reference speed to see if we have wheelspin or skidding
+  // speedMPH is this wheel's speed at now (WheelBank passes the prediction it publishes)
+  void checkWheelState(WheelMicros now, float speedMPH) {
+    float reference = vehicleSpeedMPH > SLIP_MIN_REFERENCE_MPH ? vehicleSpeedMPH : SLIP_MIN_REFERENCE_MPH;
+    slipRatio = (speedMPH - vehicleSpeedMPH) / reference;
+
+    // Hysteresis: leaving a state takes less slip than entering it
+    WheelState target = wheelState;
+    if (wheelState != SPIN && slipRatio > wheelSpinEnterSlip) {
+      target = SPIN;
+    } else if (wheelState != SKID && slipRatio < wheelSkidEnterSlip) {
+      target = SKID;
+    } else if ((wheelState == SPIN && slipRatio < wheelSpinExitSlip) || (wheelState == SKID && slipRatio > wheelSkidExitSlip)) {
+      target = GOOD;
     }
-    
-    float speedDifference = wheelSpeedMPH - vehicleSpeedMPH;
-    
-    if (speedDifference > wheelSpinThreshold) {
-      wheelState = SPIN;
-    } else if (speedDifference < -wheelSkidThreshold) {
-      wheelState = SKID;
-    } else {
-      wheelState = GOOD;
+
+    if (target != pendingState) {
+      pendingState = target;
+      pendingSinceMicros = now;
     }
-  }
 
-  // Runs all of the above functions for simpler calls in loop()
-  void updateWheelStatus() {
-    calculateRPM();
-    checkZeroRPM();
-    checkWheelState();
+    if (pendingState != wheelState
+        && now - pendingSinceMicros >= WheelMicros(WHEEL_STATE_ENTER_MICROS)
+        && now - stateSinceMicros >= WheelMicros(WHEEL_STATE_MIN_DWELL_MICROS)) {
+      wheelState = pendingState;
+      stateSinceMicros = now;
+    }
   }
-  
-  // Call this from ISR - handles debouncing
+
+  // Call this from ISR - timestamps the edge in software and queues it
   void handleInterrupt() {
-    unsigned long now = micros();
-    
+    handleEdge(wheelMicros());
+  }
+
+  // Called by the input backend (the GPIO ISR, or the wheel task for captures) - handles debouncing and queues the edge for calculateRPM()
+  void handleEdge(WheelMicros edgeMicros) {
     // Debounce: ignore triggers that are too close together
     // This prevents double-triggers from noise/bouncing
-    unsigned long timeSinceLast = now - currentReadingMicros;
-    if (timeSinceLast < MIN_PULSE_INTERVAL) {
+    // The window scales with the wheel's own tooth period (see DEBOUNCE_PERIOD_FRACTION)
+    WheelMicros timeSinceLast = edgeMicros - lastEdgeMicros;
+    if (timeSinceLast < WheelMicros(debounceMicros)) {
+      debounceRejects = debounceRejects + 1;
       return;  // Too fast, likely bounce/noise
     }
+    lastEdgeMicros = edgeMicros;
     
-    // Update timestamps
-    lastReadingMicros = currentReadingMicros;
-    currentReadingMicros = now;
-    
-    // Signal main loop to calculate
-    updateFlag = true;
+    // Hand the timestamp to the main loop; if it has fallen too far behind, count the loss
+    if (!edgeQueue.push(edgeMicros)) {
+      droppedEdges = droppedEdges + 1;
+    }
+  }
+
+  // Called from the processing task when an input backend knows edges were missed (e.g. hardware counted more than were timestamped)
+  // The next edge only re-establishes the baseline instead of producing a multi-tooth interval
+  void resync() {
+    ignoreNextReading = true;
+    debounceMicros = MinPulseInterval;
   }
-};
\ No newline at end of file
+};
+
+// The wheel configuration used on the car
+typedef Wheel<targetsPerRevolution, wheelAvgSamples> VehicleWheel;
\ No newline at end of file
@@ -0,0 +1,175 @@
+/*
+
+  WheelBank runs all four wheels as one unit.
+
+  Each Wheel still owns its ISR queue, edge history and estimator state, including the last
+  edge time, next expected edge, tooth period, speed and acceleration, since those are driven
+  one edge at a time. Everything that has to happen on every update (zero/overdue checks,
+  extrapolating between edges, handing values to CAN) works from one wheelMicros() sample, so
+  the four speeds always describe the same instant. The arrays below are copies gathered from
+  the wheels on each update, not a structure-of-arrays store, and the pass over them isn't
+  vectorised (the ESP32 has no SIMD float unit to vectorise it for).
+
+  The point is coherence, not speed. On the host (WheelPipelineTest) an update with one edge
+  per wheel takes about the same time either way: ~80 scaled cycles through the bank against
+  73-87 for four wheels updated one at a time, the spread being run to run noise.
+  The vehicle reference speed (VehicleSpeed.h) is updated from those same four speeds before
+  any wheel is checked for spin or skid, so that check also runs at the wheel update rate.
+  The result is published as a WheelSnapshot behind a sequence counter, so a reader on another
+  core (the CAN task, later analysis stages) never sees half of one update and half of another.
+  Learned tooth tables are saved from here too, once all four wheels read zero.
+
+*/
+
+#pragma once
+
+#include <atomic>
+
+const int WHEEL_COUNT = 4;
+
+// Index of each wheel in the bank's arrays and snapshots
+enum WheelPosition {
+  FRONT_LEFT,
+  FRONT_RIGHT,
+  REAR_LEFT,
+  REAR_RIGHT
+};
+
+// One coherent set of wheel outputs, all evaluated at sampleMicros
+struct WheelSnapshot {
+  WheelMicros sampleMicros;
+  float speedMPH[WHEEL_COUNT];           // Predicted to sampleMicros
+  float accelerationMPHps[WHEEL_COUNT];
+  int state[WHEEL_COUNT];                // WheelState
+  float slipRatio[WHEEL_COUNT];
+  float vehicleSpeedMPH;                 // Reference speed the states were judged against
+};
+
+class WheelBank {
+
+private:
+
+  VehicleWheel *wheels[WHEEL_COUNT];
+
+  // Per-update copies of each wheel's values, taken after the edge processing
+  bool valid[WHEEL_COUNT];
+  WheelMicros lastEdgeMicros[WHEEL_COUNT];
+  WheelMicros nextExpectedMicros[WHEEL_COUNT];
+  unsigned long toothMicros[WHEEL_COUNT];
+  float edgeSpeedMPH[WHEEL_COUNT];
+  float accelerationMPHps[WHEEL_COUNT];
+  float nextToothMPHMicros[WHEEL_COUNT];
+  int state[WHEEL_COUNT];
+  float slipRatio[WHEEL_COUNT];
+
+  VehicleSpeedEstimator reference;
+
+  WheelSnapshot published;
+  std::atomic<uint32_t> publishedSequence;  // Odd while published is being written
+
+public:
+
+  WheelBank(VehicleWheel &frontLeft, VehicleWheel &frontRight, VehicleWheel &rearLeft, VehicleWheel &rearRight)
+    : publishedSequence(0) {
+    wheels[FRONT_LEFT] = &frontLeft;
+    wheels[FRONT_RIGHT] = &frontRight;
+    wheels[REAR_LEFT] = &rearLeft;
+    wheels[REAR_RIGHT] = &rearRight;
+    memset(&published, 0, sizeof(published));
+  }
+
+  VehicleWheel &wheel(int position) {
+    return *wheels[position];
+  }
+
+  VehicleSpeedEstimator &vehicleSpeed() {
+    return reference;
+  }
+
+  // Runs calculateRPM(), checkZeroRPM() and the state checks for every wheel, with tire scaling and prediction
+  void update() {
+    // Drain every wheel's edges first, then take one timestamp that is newer than all of them
+    for (int i = 0; i < WHEEL_COUNT; i++) {
+      wheels[i]->calculateRPM();
+    }
+    WheelMicros now = wheelMicros();
+
+    for (int i = 0; i < WHEEL_COUNT; i++) {
+      VehicleWheel &w = *wheels[i];
+      w.checkZeroRPM(now);
+
+      valid[i] = w.hasSpeedEstimate();
+      lastEdgeMicros[i] = w.lastReadingMicros;
+      nextExpectedMicros[i] = w.nextExpectedMicros;
+      toothMicros[i] = w.lastToothMicros;
+      // Everything downstream (prediction, reference speed, slip, CAN) sees the calibrated tire size
+      edgeSpeedMPH[i] = w.wheelSpeedMPH * w.tireScale;
+      accelerationMPHps[i] = w.wheelAccelerationMPHps * w.tireScale;
+      nextToothMPHMicros[i] = w.nextToothMPHMicros() * w.tireScale;
+    }
+
+    // Extrapolate every wheel to the same instant
+    float speedMPH[WHEEL_COUNT];
+    for (int i = 0; i < WHEEL_COUNT; i++) {
+      speedMPH[i] = valid[i] ? predictWheelSpeedMPH(now, lastEdgeMicros[i], nextExpectedMicros[i], toothMicros[i],
+                                                    edgeSpeedMPH[i], accelerationMPHps[i], nextToothMPHMicros[i])
+                             : edgeSpeedMPH[i];
+    }
+
+    // Spin/skid is judged against a reference built from this same update
+    vehicleSpeedMPH = reference.update(now, speedMPH);
+    for (int i = 0; i < WHEEL_COUNT; i++) {
+      wheels[i]->checkWheelState(now, speedMPH[i]);
+      state[i] = wheels[i]->wheelState;
+      slipRatio[i] = wheels[i]->slipRatio;
+    }
+
+    publish(now, speedMPH);
+    saveToothCalibrationsWhenStopped(speedMPH);
+  }
+
+  // Copy of the latest snapshot; safe to call from any task or core
+  WheelSnapshot snapshot() {
+    WheelSnapshot copy;
+    uint32_t before, after;
+    do {
+      before = publishedSequence.load(std::memory_order_acquire);
+      memcpy(&copy, &published, sizeof(copy));
+      std::atomic_thread_fence(std::memory_order_acquire);
+      after = publishedSequence.load(std::memory_order_relaxed);
+    } while ((before & 1) || before != after);
+    return copy;
+  }
+
+private:
+
+  // Flash writes turn the cache off, and the GPIO wheel interrupt isn't in IRAM, so a save while any
+  // wheel is still turning would delay or merge its edges. Same rule as TireCalibrator::update()
+  void saveToothCalibrationsWhenStopped(const float *speedMPH) {
+    for (int i = 0; i < WHEEL_COUNT; i++) {
+      if (speedMPH[i] != 0) return;
+    }
+    for (int i = 0; i < WHEEL_COUNT; i++) {
+      if (wheels[i]->toothCalibrationUnsaved()) {
+        wheels[i]->saveToothCalibration();
+      }
+    }
+  }
+
+  void publish(WheelMicros now, const float *speedMPH) {
+    uint32_t sequence = publishedSequence.load(std::memory_order_relaxed);
+    publishedSequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    published.sampleMicros = now;
+    for (int i = 0; i < WHEEL_COUNT; i++) {
+      published.speedMPH[i] = speedMPH[i];
+      published.accelerationMPHps[i] = accelerationMPHps[i];
+      published.state[i] = state[i];
+      published.slipRatio[i] = slipRatio[i];
+    }
+    published.vehicleSpeedMPH = vehicleSpeedMPH;
+
+    publishedSequence.store(sequence + 2, std::memory_order_release);
+  }
+};
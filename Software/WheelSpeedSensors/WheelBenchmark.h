@@ -0,0 +1,98 @@
+/*
+
+  On-device timing of the wheel speed pipelines and the shock filter.
+
+  Set RUN_WHEEL_BENCHMARK to true in WheelSpeedSensors.ino and the ESP32 will print the
+  average CPU cycles each estimator/pipeline combination spends per wheel edge before
+  the sensors are attached. Edges are fed straight into Wheel::processEdge(), so the
+  numbers cover only the speed math and not ISR or queueing overhead. The host build in
+  test/ runs the same benchmark from WheelPipelineTest, after checking that the integer
+  and float pipelines agree; its numbers say nothing about which pipeline is faster on
+  the ESP32 (see defaultIntegerPipeline in Wheel.h).
+
+  The shock filter is timed per raw sample (one channel) and checked against its budget:
+  the four channels together have to fit well inside one SHOCK_SAMPLE_RATE_HZ period on
+  loop()'s core alongside everything else, so it should stay far under 1% of it.
+
+*/
+
+#pragma once
+
+const int BENCHMARK_EDGES = 2000;
+const float BENCHMARK_SPEED_MPH = 20;
+
+// Feeds a synthetic constant-speed pulse train with a few microseconds of jitter into a
+// fresh Wheel and returns the average CPU cycles per edge
+uint32_t benchmarkWheelUpdate(int sensorPin, SpeedEstimator estimator, bool integerPipeline) {
+  VehicleWheel wheel(sensorPin);
+  wheel.speedEstimator = estimator;
+  wheel.integerPipeline = integerPipeline;
+
+  unsigned long toothMicros = (unsigned long)(60000000.0 / (BENCHMARK_SPEED_MPH / rpmToMphFactor) / VehicleWheel::TARGETS);
+  WheelMicros edgeMicros = 0;
+  uint32_t noise = 12345;
+
+  // Timed as one run so the clock reads don't swamp the few dozen cycles an edge takes (on a PC a
+  // clock read costs more than that); the LCG adds the same couple of cycles to every combination
+  uint32_t start = ESP.getCycleCount();
+  for (int i = 0; i < BENCHMARK_EDGES; i++) {
+    noise = noise * 1664525 + 1013904223;  // LCG, +/-16us of jitter
+    edgeMicros += toothMicros + (noise >> 27) - 16;
+    wheel.processEdge(edgeMicros);
+  }
+  uint32_t totalCycles = ESP.getCycleCount() - start;
+
+  // Keeps the run from being optimised away
+  if (wheel.wheelSpeedCentiMPH == 0 && wheel.wheelSpeedMPH == 0) Serial.println("Wheel benchmark produced no speed");
+  return totalCycles / BENCHMARK_EDGES;
+}
+
+const int BENCHMARK_SHOCK_SAMPLES = 10000;
+
+// Average CPU cycles ShockFilter::add() takes per raw reading, outputs included
+uint32_t benchmarkShockFilter() {
+  ShockFilter filter;
+  uint32_t noise = 12345;
+  uint32_t totalCycles = 0;
+  int32_t outputQ4 = 0;
+  int outputs = 0;
+
+  for (int i = 0; i < BENCHMARK_SHOCK_SAMPLES; i++) {
+    noise = noise * 1664525 + 1013904223;  // LCG, mid-scale reading with +/-32 counts of noise
+    int reading = 2048 + (noise >> 26) - 32;
+
+    uint32_t start = ESP.getCycleCount();
+    if (filter.add(reading, outputQ4)) outputs++;
+    totalCycles += ESP.getCycleCount() - start;
+  }
+
+  // Keeps the filter from being optimised away
+  if (outputs == 0 || outputQ4 == 0) Serial.println("Shock filter produced no output");
+  return totalCycles / BENCHMARK_SHOCK_SAMPLES;
+}
+
+void printWheelBenchmark(const char *label, uint32_t cycles) {
+  Serial.print(label);
+  Serial.print(": ");
+  Serial.print(cycles);
+  Serial.print(" cycles/update (");
+  Serial.print(cycles * 1000 / ESP.getCpuFreqMHz());
+  Serial.println(" ns)");
+}
+
+void runWheelBenchmark(int sensorPin) {
+  Serial.println("Wheel pipeline benchmark:");
+  printWheelBenchmark("  float   AVERAGE_INTERVALS", benchmarkWheelUpdate(sensorPin, AVERAGE_INTERVALS, false));
+  printWheelBenchmark("  integer AVERAGE_INTERVALS", benchmarkWheelUpdate(sensorPin, AVERAGE_INTERVALS, true));
+  printWheelBenchmark("  float   MULTI_TOOTH", benchmarkWheelUpdate(sensorPin, MULTI_TOOTH, false));
+  printWheelBenchmark("  integer MULTI_TOOTH", benchmarkWheelUpdate(sensorPin, MULTI_TOOTH, true));
+  printWheelBenchmark("  float   ALPHA_BETA", benchmarkWheelUpdate(sensorPin, ALPHA_BETA, false));
+  printWheelBenchmark("  integer ALPHA_BETA", benchmarkWheelUpdate(sensorPin, ALPHA_BETA, true));
+
+  uint32_t shockCycles = benchmarkShockFilter();
+  printWheelBenchmark("  shock filter (per sample)", shockCycles);
+  uint32_t budgetCycles = ESP.getCpuFreqMHz() * 1000000 / SHOCK_SAMPLE_RATE_HZ;
+  Serial.print("  shock filter, 4 channels: ");
+  Serial.print(4 * shockCycles * 100.0 / budgetCycles, 2);
+  Serial.println("% of one sample period");
+}
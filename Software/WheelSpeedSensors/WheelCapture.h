@@ -0,0 +1,237 @@
+/*
+
+  Hardware-timestamped wheel inputs using the ESP32 MCPWM capture units.
+
+  With attachInterrupt() each edge is timestamped by micros() inside the ISR, so every
+  period picks up however long the interrupt took to be serviced. The MCPWM capture
+  unit instead latches the 80 MHz APB timer the instant the edge arrives, so the edge
+  time no longer depends on when the interrupt gets serviced. There are three capture
+  channels per MCPWM unit, so the four wheels use unit 0 channels 0-2 and unit 1 channel 0.
+
+  The MCPWM driver registers its interrupt with ESP_INTR_FLAG_IRAM, so the callback keeps
+  running while the flash cache is off for an NVS write (tooth, tire and shock
+  calibrations all save while wheels may still be turning). It must not touch anything in
+  flash: it only queues the latched count with a wheelMicros() sample and wakes the wheel
+  task, and poll() converts the queued counts and hands them to the Wheel from the task.
+
+  Each wheel pin is also routed to a PCNT unit that counts rising edges in hardware.
+  If the counter ever runs ahead of the queued captures (e.g. two edges inside one
+  interrupt latency at high speed, or the queue was full) we know a timestamp is missing
+  and tell the Wheel to re-establish its baseline instead of using a multi-tooth interval.
+
+  CaptureClock holds all of the tick-to-microsecond math and has no hardware
+  dependencies, so the same conversion can be driven with made-up capture values.
+
+*/
+
+#pragma once
+
+#include "driver/mcpwm.h"
+#include "driver/pcnt.h"
+
+// MCPWM capture timer runs directly from the 80 MHz APB clock
+const uint32_t CAPTURE_TICKS_PER_MICRO = 80;
+
+// The 32-bit capture timer wraps every ~53 seconds, so an edge arriving long after the
+// previous one cannot be trusted to have a single wrap. Any interval this long is far past
+// MIN_PULSE_INTERVAL resolution concerns, so we just re-anchor to wheelMicros() instead
+const unsigned long CAPTURE_REANCHOR_MICROS = 1000000;
+
+// PCNT glitch filter in APB ticks (1023 is the hardware maximum, ~12.8us)
+const uint16_t PCNT_FILTER_TICKS = 1023;
+
+// PCNT counters are 16-bit; they reset to zero when they reach this limit
+const int16_t PCNT_COUNT_LIMIT = 32767;
+
+const int CAPTURE_CHANNEL_COUNT = 4;
+
+// Captures queued per wheel between wheel task passes; a power of two
+const unsigned long CAPTURE_QUEUE_SIZE = 16;
+
+// Extends latched 32-bit capture timer values into 64-bit timestamps in the wheelMicros() time base
+class CaptureClock {
+
+private:
+
+  bool anchored;
+  uint32_t lastTicks;           // Capture value of the previous edge
+  WheelMicros lastMicros;       // Timestamp we assigned to the previous edge
+  uint32_t remainderTicks;      // Sub-microsecond ticks carried into the next conversion
+
+public:
+
+  CaptureClock() {
+    anchored = false;
+    lastTicks = 0;
+    lastMicros = 0;
+    remainderTicks = 0;
+  }
+
+  // captureTicks is the hardware-latched timer value, nowMicros is wheelMicros() sampled in the ISR
+  WheelMicros toMicros(uint32_t captureTicks, WheelMicros nowMicros) {
+    if (!anchored || (nowMicros - lastMicros) > WheelMicros(CAPTURE_REANCHOR_MICROS)) {
+      anchored = true;
+      lastTicks = captureTicks;
+      lastMicros = nowMicros;
+      remainderTicks = 0;
+      return nowMicros;
+    }
+
+    // Unsigned subtraction handles the capture timer wrapping between edges
+    uint32_t elapsedTicks = (captureTicks - lastTicks) + remainderTicks;
+    lastTicks = captureTicks;
+    lastMicros += elapsedTicks / CAPTURE_TICKS_PER_MICRO;
+    remainderTicks = elapsedTicks % CAPTURE_TICKS_PER_MICRO;
+    return lastMicros;
+  }
+};
+
+// One capture as the ISR saw it, converted later by poll()
+struct CapturedEdge {
+  uint32_t ticks;     // Latched capture timer value
+  WheelMicros micros; // wheelMicros() in the ISR, for anchoring CaptureClock
+};
+
+// Everything the capture ISR needs for one wheel, passed to it as user data. The ISR only
+// touches this struct (DRAM) and IRAM functions; everything else is done by poll()
+struct CaptureSlot {
+  VehicleWheel *wheel;
+  int position;  // WheelPosition, for waking the wheel task
+  CaptureClock clock;
+  volatile CapturedEdge queue[CAPTURE_QUEUE_SIZE];
+  volatile unsigned long captureEvents;  // Captures queued since begin(), written only by the ISR
+  volatile unsigned long drainedEvents;  // Captures handed to the Wheel, written only by poll()
+  pcnt_unit_t pcntUnit;
+  int16_t lastPcntCount;
+  unsigned long countedEdges;    // Rising edges counted by PCNT since begin()
+  long maxDeficit;               // Highest countedEdges - captureEvents seen by poll() so far
+  unsigned long missedCaptures;  // Edges PCNT saw that never produced a timestamp
+};
+
+class WheelCaptureInput {
+
+private:
+
+  CaptureSlot slots[CAPTURE_CHANNEL_COUNT];
+
+  static bool IRAM_ATTR onCapture(mcpwm_unit_t, mcpwm_capture_channel_id_t, const cap_event_data_t *edata, void *userData) {
+    CaptureSlot *slot = (CaptureSlot *)userData;
+    unsigned long head = slot->captureEvents;
+
+    // A full queue drops the capture; PCNT still counts the edge, so poll() resyncs the wheel
+    if (head - slot->drainedEvents < CAPTURE_QUEUE_SIZE) {
+      volatile CapturedEdge &edge = slot->queue[head & (CAPTURE_QUEUE_SIZE - 1)];
+      edge.ticks = edata->cap_value;
+      edge.micros = wheelMicros();  // esp_timer_get_time() is in IRAM
+      slot->captureEvents = head + 1;  // Volatile stores stay in order, so the entry is complete first
+    }
+    return notifyWheelTaskFromISR(slot->position);  // Driver yields to the wheel task if it was woken
+  }
+
+  void setupChannel(int index, VehicleWheel &wheel) {
+    CaptureSlot &slot = slots[index];
+    slot.wheel = &wheel;
+    slot.position = index;
+    slot.captureEvents = 0;
+    slot.drainedEvents = 0;
+    slot.pcntUnit = (pcnt_unit_t)index;
+    slot.lastPcntCount = 0;
+    slot.countedEdges = 0;
+    slot.maxDeficit = 0;
+    slot.missedCaptures = 0;
+
+    mcpwm_unit_t unit = (index < 3) ? MCPWM_UNIT_0 : MCPWM_UNIT_1;
+    int channel = index % 3;
+
+    mcpwm_gpio_init(unit, (mcpwm_io_signals_t)(MCPWM_CAP_0 + channel), wheel.sensorPin);
+
+    mcpwm_capture_config_t captureConfig;
+    memset(&captureConfig, 0, sizeof(captureConfig));
+    captureConfig.cap_edge = MCPWM_POS_EDGE;  // Sensor goes HIGH over metal, same as the RISING interrupt
+    captureConfig.cap_prescale = 1;
+    captureConfig.capture_cb = onCapture;
+    captureConfig.user_data = &slot;
+    if (mcpwm_capture_enable_channel(unit, (mcpwm_capture_channel_id_t)(MCPWM_SELECT_CAP0 + channel), &captureConfig) != ESP_OK) {
+      Serial.print("Failed to enable MCPWM capture on pin ");
+      Serial.println(wheel.sensorPin);
+    }
+
+    pcnt_config_t counterConfig;
+    memset(&counterConfig, 0, sizeof(counterConfig));
+    counterConfig.pulse_gpio_num = wheel.sensorPin;
+    counterConfig.ctrl_gpio_num = PCNT_PIN_NOT_USED;
+    counterConfig.lctrl_mode = PCNT_MODE_KEEP;
+    counterConfig.hctrl_mode = PCNT_MODE_KEEP;
+    counterConfig.pos_mode = PCNT_COUNT_INC;
+    counterConfig.neg_mode = PCNT_COUNT_DIS;
+    counterConfig.counter_h_lim = PCNT_COUNT_LIMIT;
+    counterConfig.counter_l_lim = 0;
+    counterConfig.unit = slot.pcntUnit;
+    counterConfig.channel = PCNT_CHANNEL_0;
+    if (pcnt_unit_config(&counterConfig) != ESP_OK) {
+      Serial.print("Failed to configure PCNT on pin ");
+      Serial.println(wheel.sensorPin);
+      return;
+    }
+    pcnt_set_filter_value(slot.pcntUnit, PCNT_FILTER_TICKS);
+    pcnt_filter_enable(slot.pcntUnit);
+    pcnt_counter_pause(slot.pcntUnit);
+    pcnt_counter_clear(slot.pcntUnit);
+    pcnt_counter_resume(slot.pcntUnit);
+  }
+
+public:
+
+  // Replaces attachInterrupt() for the four wheels
+  void begin(VehicleWheel &frontLeft, VehicleWheel &frontRight, VehicleWheel &rearLeft, VehicleWheel &rearRight) {
+    setupChannel(0, frontLeft);
+    setupChannel(1, frontRight);
+    setupChannel(2, rearLeft);
+    setupChannel(3, rearRight);
+  }
+
+  // Call from the wheel task before each update - hands the queued captures to their Wheel and
+  // compares the hardware edge count against them
+  void poll() {
+    for (int i = 0; i < CAPTURE_CHANNEL_COUNT; i++) {
+      CaptureSlot &slot = slots[i];
+
+      // PCNT first: a capture queued after this read only makes the deficit smaller, never larger
+      int16_t count;
+      bool counted = pcnt_get_counter_value(slot.pcntUnit, &count) == ESP_OK;
+      unsigned long events = slot.captureEvents;
+
+      for (unsigned long e = slot.drainedEvents; e != events; e++) {
+        volatile CapturedEdge &edge = slot.queue[e & (CAPTURE_QUEUE_SIZE - 1)];
+        slot.wheel->handleEdge(slot.clock.toMicros(edge.ticks, edge.micros));
+      }
+      slot.drainedEvents = events;
+
+      if (!counted) continue;
+      int countDelta = count - slot.lastPcntCount;
+      if (countDelta < 0) countDelta += PCNT_COUNT_LIMIT;
+      slot.lastPcntCount = count;
+      slot.countedEdges += countDelta;
+
+      // Totals since begin(). PCNT's glitch filter holds each edge back by up to PCNT_FILTER_TICKS,
+      // while the capture ISR has usually queued it and woken us by then, so PCNT regularly trails
+      // by one and catches up on a later poll. Neither that nor a glitch only the capture unit saw
+      // (which leaves PCNT behind for good) loses a timestamp, so only a deficit above the highest
+      // one seen so far means PCNT counted an edge that never got captured
+      long deficit = long(slot.countedEdges - events);
+      if (deficit > slot.maxDeficit) {
+        slot.missedCaptures += deficit - slot.maxDeficit;
+        slot.maxDeficit = deficit;
+        slot.wheel->resync();
+      }
+    }
+  }
+
+  unsigned long countedEdges(int index) {
+    return slots[index].countedEdges;
+  }
+
+  unsigned long missedCaptures(int index) {
+    return slots[index].missedCaptures;
+  }
+};
@@ -0,0 +1,101 @@
+/*
+
+  On-demand reporting of each wheel's pulse quality counters (WheelDiagnostics in Wheel.h).
+
+  Serial: send 'd' to print all four wheels.
+
+  CAN: any node sends an int on wheelDiagnosticsRequest_ID holding a bitmask of the wheels it
+  wants (bit 0 = front left ... bit 3 = rear right, 0xF for all). Each field comes back as its
+  own frame on wheelDiagnostics_ID via sendCANIndexedInt(): byte 0 is the WheelPosition, byte 1
+  the WheelDiagnosticField below and bytes 4-7 the value.
+
+  Counters only ever count up; diff two requests to see what happened in between.
+
+*/
+
+#pragma once
+
+enum WheelDiagnosticField {
+  DIAG_ACCEPTED_EDGES,
+  DIAG_DEBOUNCE_REJECTS,
+  DIAG_SHORT_REJECTS,
+  DIAG_OVER_RANGE_REJECTS,
+  DIAG_TIMEOUTS,
+  DIAG_BASELINE_RESETS,
+  DIAG_DROPPED_EDGES,
+  DIAG_JITTER_BUCKET_0  // Followed by the rest of the JITTER_BUCKET_COUNT buckets
+};
+
+const char WHEEL_DIAGNOSTICS_SERIAL_COMMAND = 'd';
+
+void printWheelDiagnostics(const char *label, VehicleWheel &wheel) {
+  const WheelDiagnostics &diagnostics = wheel.diagnostics;
+  Serial.print(label);
+  Serial.print(" accepted:");
+  Serial.print(diagnostics.acceptedEdges);
+  Serial.print(" debounce:");
+  Serial.print(wheel.debounceRejects);
+  Serial.print(" short:");
+  Serial.print(diagnostics.shortRejects);
+  Serial.print(" overRange:");
+  Serial.print(diagnostics.overRangeRejects);
+  Serial.print(" timeouts:");
+  Serial.print(diagnostics.timeouts);
+  Serial.print(" resets:");
+  Serial.print(diagnostics.baselineResets);
+  Serial.print(" dropped:");
+  Serial.println(wheel.droppedEdges);
+
+  // One line per bucket, labelled with its range in percent
+  for (int i = 0; i < JITTER_BUCKET_COUNT; i++) {
+    Serial.print("  jitter ");
+    if (i == 0) {
+      Serial.print("      < ");
+      Serial.print(JITTER_BUCKET_LIMITS_PERMILLE[0] / 10.0, 1);
+    } else if (i == JITTER_BUCKET_COUNT - 1) {
+      Serial.print("     >= ");
+      Serial.print(JITTER_BUCKET_LIMITS_PERMILLE[i - 1] / 10.0, 1);
+    } else {
+      Serial.print(JITTER_BUCKET_LIMITS_PERMILLE[i - 1] / 10.0, 1);
+      Serial.print(" .. ");
+      Serial.print(JITTER_BUCKET_LIMITS_PERMILLE[i] / 10.0, 1);
+    }
+    Serial.print("%: ");
+    Serial.println(diagnostics.jitterHistogram[i]);
+  }
+}
+
+void sendWheelDiagnosticsCAN(int position, VehicleWheel &wheel) {
+  const WheelDiagnostics &diagnostics = wheel.diagnostics;
+  sendCANIndexedInt(wheelDiagnostics_ID, position, DIAG_ACCEPTED_EDGES, diagnostics.acceptedEdges);
+  sendCANIndexedInt(wheelDiagnostics_ID, position, DIAG_DEBOUNCE_REJECTS, wheel.debounceRejects);
+  sendCANIndexedInt(wheelDiagnostics_ID, position, DIAG_SHORT_REJECTS, diagnostics.shortRejects);
+  sendCANIndexedInt(wheelDiagnostics_ID, position, DIAG_OVER_RANGE_REJECTS, diagnostics.overRangeRejects);
+  sendCANIndexedInt(wheelDiagnostics_ID, position, DIAG_TIMEOUTS, diagnostics.timeouts);
+  sendCANIndexedInt(wheelDiagnostics_ID, position, DIAG_BASELINE_RESETS, diagnostics.baselineResets);
+  sendCANIndexedInt(wheelDiagnostics_ID, position, DIAG_DROPPED_EDGES, wheel.droppedEdges);
+  for (int i = 0; i < JITTER_BUCKET_COUNT; i++) {
+    sendCANIndexedInt(wheelDiagnostics_ID, position, DIAG_JITTER_BUCKET_0 + i, diagnostics.jitterHistogram[i]);
+  }
+}
+
+// For WHEEL_DIAGNOSTICS_SERIAL_COMMAND (loop() owns reading the Serial commands)
+void printWheelDiagnostics(WheelBank &bank) {
+  const char *labels[WHEEL_COUNT] = { "frontLeftWheel", "frontRightWheel", "rearLeftWheel", "rearRightWheel" };
+  for (int i = 0; i < WHEEL_COUNT; i++) {
+    printWheelDiagnostics(labels[i], bank.wheel(i));
+  }
+}
+
+// Call from loop(); does nothing unless a report was asked for over CAN
+void serviceWheelDiagnostics(WheelBank &bank) {
+  // Taken in one step: a request the CAN task adds in between is kept for the next call
+  int requested = wheelDiagnosticsRequest.exchange(0);
+  if (requested != 0) {
+    for (int i = 0; i < WHEEL_COUNT; i++) {
+      if (requested & (1 << i)) {
+        sendWheelDiagnosticsCAN(i, bank.wheel(i));
+      }
+    }
+  }
+}
@@ -0,0 +1,97 @@
+/*
+
+  One GPIO interrupt handler for all four wheel inputs.
+
+  attachInterrupt() goes through the IDF GPIO ISR service, which loops over the status
+  register and calls a separate handler per pin, and each of our handlers then took its
+  own timestamp. Two wheels edging together were serialized and stamped a few
+  microseconds apart, which shows up directly as a left/right speed difference.
+
+  Here we own the GPIO interrupt ourselves: read the status register once, take one
+  timestamp, clear exactly the bits we read and hand every pending wheel edge the same
+  timestamp before waking the wheel task once.
+
+  This replaces attachInterrupt() for the whole chip, so nothing else in the sketch may
+  use GPIO interrupts while it is active. All wheel pins must be below 32 (GPIO.status
+  only covers the low bank).
+
+*/
+
+#pragma once
+
+#include "driver/gpio.h"
+#include "soc/gpio_struct.h"
+
+class WheelGpioInput {
+
+private:
+
+  VehicleWheel *wheels[WHEEL_COUNT];
+  uint32_t pinMasks[WHEEL_COUNT];
+  uint32_t allPinsMask;
+  intr_handle_t interruptHandle;
+
+  static void IRAM_ATTR onGpioInterrupt(void *userData) {
+    WheelGpioInput *input = (WheelGpioInput *)userData;
+
+    uint32_t status = GPIO.status;
+    WheelMicros edgeMicros = wheelMicros();  // Same timestamp for every wheel pending in this status read
+    GPIO.status_w1tc = status;
+
+    uint32_t notifiedWheels = 0;
+    for (int i = 0; i < WHEEL_COUNT; i++) {
+      if (status & input->pinMasks[i]) {
+        input->wheels[i]->handleEdge(edgeMicros);
+        notifiedWheels |= 1UL << i;
+      }
+    }
+
+    if (notifiedWheels != 0 && wheelTaskHandle != NULL) {
+      BaseType_t woken = pdFALSE;
+      xTaskNotifyFromISR(wheelTaskHandle, notifiedWheels, eSetBits, &woken);
+      if (woken == pdTRUE) portYIELD_FROM_ISR();
+    }
+  }
+
+  void setupPin(int position, VehicleWheel &wheel) {
+    wheels[position] = &wheel;
+    pinMasks[position] = 1UL << wheel.sensorPin;
+    allPinsMask |= pinMasks[position];
+
+    // Sensor goes HIGH over metal, same as the RISING interrupt
+    gpio_set_intr_type((gpio_num_t)wheel.sensorPin, GPIO_INTR_POSEDGE);
+  }
+
+public:
+
+  WheelGpioInput() {
+    allPinsMask = 0;
+    interruptHandle = NULL;
+  }
+
+  // Replaces attachInterrupt() for the four wheels
+  void begin(VehicleWheel &frontLeft, VehicleWheel &frontRight, VehicleWheel &rearLeft, VehicleWheel &rearRight) {
+    if (frontLeft.sensorPin >= 32 || frontRight.sensorPin >= 32 || rearLeft.sensorPin >= 32 || rearRight.sensorPin >= 32) {
+      Serial.println("Wheel GPIO input needs all wheel pins below 32");
+      return;
+    }
+
+    setupPin(FRONT_LEFT, frontLeft);
+    setupPin(FRONT_RIGHT, frontRight);
+    setupPin(REAR_LEFT, rearLeft);
+    setupPin(REAR_RIGHT, rearRight);
+
+    // Clear anything latched while the pins were being configured
+    GPIO.status_w1tc = allPinsMask;
+
+    // Not ESP_INTR_FLAG_IRAM: the Wheel code runs from flash, so the interrupt has to wait out NVS writes
+    if (gpio_isr_register(onGpioInterrupt, this, 0, &interruptHandle) != ESP_OK) {
+      Serial.println("Failed to register wheel GPIO interrupt");
+      return;
+    }
+
+    for (int i = 0; i < WHEEL_COUNT; i++) {
+      gpio_intr_enable((gpio_num_t)wheels[i]->sensorPin);
+    }
+  }
+};
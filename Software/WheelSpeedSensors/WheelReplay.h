@@ -0,0 +1,210 @@
+/*
+
+  Replay of synthetic pulse trains through the full wheel pipeline, with pass/fail limits.
+
+  The host build in test/ runs it as WheelReplayTest (ctest fails if any limit is
+  exceeded), and with RUN_WHEEL_REPLAY set to true in WheelSpeedSensors.ino the ESP32 runs
+  the same scenarios before the sensors are attached. Unlike WheelBenchmark.h, edges go
+  through handleEdge() (debounce and ISR queue), calculateRPM() and checkZeroRPM() on a
+  virtual clock that ticks once per simulated loop(), so the reported speed can be
+  compared against the known true speed at every tick.
+
+  Scenarios can also start hours into a run and/or route every edge through the MCPWM
+  CaptureClock (32-bit, 80 MHz ticks that wrap every ~53 s), which covers the conversion
+  into 64-bit wheelMicros() timestamps.
+
+  For each scenario and estimator this prints:
+    rms/max   error of the predicted speed (what WheelBank publishes) after it settles
+    latency   time after the scenario's event until the error stays under REPLAY_LATENCY_TOLERANCE_MPH
+    cyc/edge  CPU cycles calculateRPM() spent per edge (and the same in ns)
+  and FAIL if rms, max or latency is over the scenario's limit. Every estimator is held to
+  the same limits; tighten them when an estimator change earns it.
+
+*/
+
+#pragma once
+
+#include "WheelCapture.h"
+
+const unsigned long REPLAY_TICK_MICROS = 1000;          // Simulated loop() period
+const unsigned long REPLAY_DURATION_MICROS = 5000000;   // Length of every scenario
+const unsigned long REPLAY_SETTLE_MICROS = 500000;      // Ignored at the start while the estimators fill up
+const float REPLAY_LATENCY_TOLERANCE_MPH = 1.0;
+
+// Speed profiles, t in seconds since the start of the scenario
+float replayConstantSpeed(float) {
+  return 20;
+}
+
+float replayAccelerationRamp(float t) {
+  return 5 + 7 * t;  // 5 to 40 MPH
+}
+
+float replayLockup(float t) {
+  return (t < 2.5) ? 25 : 0;
+}
+
+float replayCruiseSpeed(float) {
+  return 30;
+}
+
+const WheelMicros REPLAY_ENDURANCE_START_MICROS = 4LL * 3600 * 1000000;  // Four hours in, well past 32-bit micros()
+
+struct ReplayScenario {
+  const char *name;
+  float (*speedAt)(float t);
+  WheelMicros startMicros;     // Virtual clock value at t = 0
+  unsigned long eventMicros;   // Offset latency is measured from (0 = no event)
+  bool noiseBursts;            // Add sensor bounce and EMI spikes after some edges
+  bool captureClock;           // Timestamp edges through CaptureClock; its tick counter wraps halfway through
+  float maxRmsErrorMPH;        // Limits, checked for every estimator
+  float maxErrorMPH;
+  long maxLatencyMicros;       // Only checked when there is an event
+};
+
+const ReplayScenario REPLAY_SCENARIOS[] = {
+  { "constant 20", replayConstantSpeed, 0, 0, false, false, 0.05, 0.2, 0 },
+  { "ramp 5-40", replayAccelerationRamp, 0, 0, false, false, 1.0, 2.5, 0 },
+  { "lockup 25", replayLockup, 0, 2500000, false, false, 0.05, 0.2, 1100000 },  // Zero is declared at ZERO_TIMEOUT_MICROS
+  { "noise 20", replayConstantSpeed, 0, 0, true, false, 0.1, 0.5, 0 },
+  { "4h 30", replayCruiseSpeed, REPLAY_ENDURANCE_START_MICROS, 0, false, false, 0.05, 0.2, 0 },
+  { "capture 30", replayCruiseSpeed, 0xFFFFFFFFLL - 2500000, 0, false, true, 0.05, 0.2, 0 },  // Also crosses the old micros() wrap
+};
+
+const int REPLAY_SCENARIO_COUNT = sizeof(REPLAY_SCENARIOS) / sizeof(REPLAY_SCENARIOS[0]);
+
+struct ReplayResult {
+  float rmsErrorMPH;
+  float maxErrorMPH;
+  long latencyMicros;  // -1 when the scenario has no event or never settled
+  uint32_t cyclesPerEdge;
+};
+
+ReplayResult replayScenario(const ReplayScenario &scenario, int sensorPin, SpeedEstimator estimator) {
+  VehicleWheel wheel(sensorPin);
+  wheel.speedEstimator = estimator;
+  wheel.persistToothCalibration = false;
+
+  float phase = 0;  // Fraction of a tooth since the last edge
+  uint32_t noise = 12345;
+  CaptureClock clock;
+  unsigned long edges = 0;
+  uint32_t totalCycles = 0;
+
+  float squaredErrorSum = 0;
+  unsigned long errorSamples = 0;
+  float maxErrorMPH = 0;
+  unsigned long lastOutOfToleranceMicros = 0;
+
+  for (unsigned long elapsed = 0; elapsed < REPLAY_DURATION_MICROS; elapsed += REPLAY_TICK_MICROS) {
+    WheelMicros tickStart = scenario.startMicros + elapsed;
+
+    // Teeth per microsecond is held constant across one tick, then edges fall where the phase crosses a tooth
+    float teethPerMicro = scenario.speedAt(elapsed / 1000000.0) * mphToRpmFactor * VehicleWheel::TARGETS / 60000000.0;
+    float tickOffset = 0;
+    while (teethPerMicro > 0 && tickOffset + (1 - phase) / teethPerMicro < REPLAY_TICK_MICROS) {
+      tickOffset += (1 - phase) / teethPerMicro;
+      phase = 0;
+      WheelMicros edgeMicros = tickStart + (unsigned long)tickOffset;
+
+      if (scenario.captureClock) {
+        // Hardware latches the exact edge; the ISR samples the clock a few to a few tens of microseconds later
+        uint32_t captureTicks = uint32_t((edgeMicros - scenario.startMicros - REPLAY_DURATION_MICROS / 2) * CAPTURE_TICKS_PER_MICRO);
+        noise = noise * 1664525 + 1013904223;  // LCG
+        edgeMicros = clock.toMicros(captureTicks, edgeMicros + 3 + (noise >> 27));
+      }
+
+      wheel.handleEdge(edgeMicros);
+      edges++;
+
+      if (scenario.noiseBursts) {
+        noise = noise * 1664525 + 1013904223;  // LCG
+        if ((noise >> 28) == 0) {
+          // Contact bounce right after the real edge, which the debounce should swallow
+          wheel.handleEdge(edgeMicros + 40);
+          wheel.handleEdge(edgeMicros + 90);
+        } else if ((noise >> 28) == 1) {
+          // EMI spike a quarter of the way into the next interval
+          wheel.handleEdge(edgeMicros + (unsigned long)(0.25 / teethPerMicro));
+        }
+      }
+    }
+    phase += teethPerMicro * (REPLAY_TICK_MICROS - tickOffset);
+
+    // Same order as WheelBank::update(): drain, then sample the clock
+    WheelMicros now = tickStart + REPLAY_TICK_MICROS;
+    uint32_t start = ESP.getCycleCount();
+    wheel.calculateRPM();
+    totalCycles += ESP.getCycleCount() - start;
+    wheel.checkZeroRPM(now);
+
+    float trueMPH = scenario.speedAt((elapsed + REPLAY_TICK_MICROS) / 1000000.0);
+    float errorMPH = fabsf(wheel.predictSpeedMPH(now) - trueMPH);
+
+    if (errorMPH > REPLAY_LATENCY_TOLERANCE_MPH) {
+      lastOutOfToleranceMicros = elapsed + REPLAY_TICK_MICROS;
+    }
+    bool afterEvent = scenario.eventMicros > 0 && elapsed + REPLAY_TICK_MICROS >= scenario.eventMicros;
+    if (elapsed >= REPLAY_SETTLE_MICROS && !afterEvent) {
+      squaredErrorSum += errorMPH * errorMPH;
+      errorSamples++;
+      if (errorMPH > maxErrorMPH) maxErrorMPH = errorMPH;
+    }
+  }
+
+  ReplayResult result;
+  result.rmsErrorMPH = errorSamples > 0 ? sqrtf(squaredErrorSum / errorSamples) : 0;
+  result.maxErrorMPH = maxErrorMPH;
+  result.latencyMicros = -1;
+  // Still out of tolerance on the last tick means it never settled
+  if (scenario.eventMicros > 0 && lastOutOfToleranceMicros < REPLAY_DURATION_MICROS) {
+    result.latencyMicros = (lastOutOfToleranceMicros > scenario.eventMicros) ? long(lastOutOfToleranceMicros - scenario.eventMicros) : 0;
+  }
+  result.cyclesPerEdge = edges > 0 ? totalCycles / edges : 0;
+  return result;
+}
+
+// Latency counts as over the limit if the scenario has an event and never settled
+bool replayPassed(const ReplayScenario &scenario, const ReplayResult &result) {
+  if (result.rmsErrorMPH > scenario.maxRmsErrorMPH) return false;
+  if (result.maxErrorMPH > scenario.maxErrorMPH) return false;
+  if (scenario.eventMicros > 0 && (result.latencyMicros < 0 || result.latencyMicros > scenario.maxLatencyMicros)) return false;
+  return true;
+}
+
+void printReplayResult(const char *scenarioName, const char *estimatorName, const ReplayResult &result, bool passed) {
+  char line[120];
+  snprintf(line, sizeof(line), "  %-12s %-17s rms %5.2f  max %5.2f MPH  latency ", scenarioName, estimatorName,
+           result.rmsErrorMPH, result.maxErrorMPH);
+  Serial.print(line);
+  if (result.latencyMicros >= 0) {
+    Serial.print(result.latencyMicros / 1000);
+    Serial.print(" ms");
+  } else {
+    Serial.print("-");
+  }
+  Serial.print("  ");
+  Serial.print(result.cyclesPerEdge);
+  Serial.print(" cyc/edge (");
+  Serial.print(result.cyclesPerEdge * 1000 / ESP.getCpuFreqMHz());
+  Serial.println(passed ? " ns)" : " ns)  FAIL");
+}
+
+// Returns false if any scenario/estimator pair was over its limits
+bool runWheelReplay(int sensorPin) {
+  const SpeedEstimator estimators[] = { AVERAGE_INTERVALS, MULTI_TOOTH, ALPHA_BETA };
+  const char *estimatorNames[] = { "AVERAGE_INTERVALS", "MULTI_TOOTH", "ALPHA_BETA" };
+
+  bool allPassed = true;
+  Serial.println("Wheel pulse train replay:");
+  for (int i = 0; i < REPLAY_SCENARIO_COUNT; i++) {
+    for (int e = 0; e < 3; e++) {
+      ReplayResult result = replayScenario(REPLAY_SCENARIOS[i], sensorPin, estimators[e]);
+      bool passed = replayPassed(REPLAY_SCENARIOS[i], result);
+      printReplayResult(REPLAY_SCENARIOS[i].name, estimatorNames[e], result, passed);
+      allPassed = allPassed && passed;
+    }
+  }
+  Serial.println(allPassed ? "Wheel replay passed" : "Wheel replay FAILED");
+  return allPassed;
+}
@@ -1,6 +1,48 @@
 #include "Wheel.h"
+#include "VehicleSpeed.h"
+#include "WheelBank.h"
+#include "WheelTask.h"
 #include "Shock.h"
 #include "BajaCAN.h"
+#include "WheelDiagnostics.h"
+#include "SpragClutch.h"
+#include "TireCalibration.h"
+#include "YawRate.h"
+#include "ShockHistograms.h"
+#include "ShockCalibration.h"
+
+// Set true to timestamp wheel edges with the MCPWM capture hardware instead of the shared GPIO interrupt + micros()
+#define WHEEL_CAPTURE_INPUT false
+
+#if WHEEL_CAPTURE_INPUT
+#include "WheelCapture.h"
+#else
+#include "WheelGpioInput.h"
+#endif
+
+// Set true to sample the shocks at a fixed rate from their own task instead of analogRead() in loop()
+#define SHOCK_TIMED_SAMPLING true
+
+#if SHOCK_TIMED_SAMPLING
+#include "ShockSampler.h"
+#endif
+
+// Set true to recalibrate the shock rest positions at every boot (the car must be sitting at ride height)
+#define CALIBRATE_SHOCKS_AT_BOOT false
+
+// Set true to print cycles per update for each wheel speed pipeline at boot
+#define RUN_WHEEL_BENCHMARK false
+
+#if RUN_WHEEL_BENCHMARK
+#include "WheelBenchmark.h"
+#endif
+
+// Set true to replay synthetic pulse trains through the wheel pipeline at boot and check error and latency against their limits (test/ runs the same on a PC)
+#define RUN_WHEEL_REPLAY false
+
+#if RUN_WHEEL_REPLAY
+#include "WheelReplay.h"
+#endif
 
 #define DEBUG_WHEEL false
 #define DebugWheelSerial \
@@ -23,28 +65,134 @@ const int frontRightShockPin = 33;
 const int rearRightShockPin = 13;
 
 // Wheel objects from Wheel.h definition
-Wheel frontLeftWheel(frontLeftWheelPin);
-Wheel frontRightWheel(frontRightWheelPin);
-Wheel rearLeftWheel(rearLeftWheelPin);
-Wheel rearRightWheel(rearRightWheelPin);
+VehicleWheel frontLeftWheel(frontLeftWheelPin);
+VehicleWheel frontRightWheel(frontRightWheelPin);
+VehicleWheel rearLeftWheel(rearLeftWheelPin);
+VehicleWheel rearRightWheel(rearRightWheelPin);
+
+// Processes the four wheels together and publishes one time-consistent snapshot
+WheelBank wheelBank(frontLeftWheel, frontRightWheel, rearLeftWheel, rearRightWheel);
+
+// Runs wheelBank.update() whenever a wheel ISR reports an edge
+WheelTask wheelTask(wheelBank);
 
 // Shock objects from Shock.h definition
 Shock frontLeftShock(frontLeftShockPin, true, frontLeftShock_restReading);
 Shock frontRightShock(frontRightShockPin, true, frontRightShock_restReading);
 Shock rearLeftShock(rearLeftShockPin, false, rearLeftShock_restReading);
 Shock rearRightShock(rearRightShockPin, false, rearRightShock_restReading);
+Shock *shocks[WHEEL_COUNT] = { &frontLeftShock, &frontRightShock, &rearLeftShock, &rearRightShock };
+
+#if SHOCK_TIMED_SAMPLING
+ShockSampler shockSampler;
+#endif
+
+// Classifies each wheel's sprag clutch as engaged or overrunning from the wheel task
+SpragDetector spragDetector;
+
+// Learns each wheel's effective tire size against GPS
+TireCalibrator tireCalibrator(wheelBank);
+
+// Yaw rate from the wheel speeds and how far the gyro disagrees with it
+YawRateEstimator yawRate;
+
+// Analysis stages run on every snapshot the wheel task publishes
+void analyzeWheels(const WheelSnapshot &wheels) {
+  spragDetector.update(wheels);
+  tireCalibrator.update(wheels);
+  yawRate.update(wheels);
+}
+
+#if WHEEL_CAPTURE_INPUT
+WheelCaptureInput wheelCapture;
+
+// Hand the queued captures to the wheels and catch any edges the hardware counted but never timestamped
+void pollWheelCapture() {
+  wheelCapture.poll();
+}
+#else
+WheelGpioInput wheelGpio;
+#endif
+
+// Single reader for Serial so each report only sees its own command
+void serviceSerialCommands() {
+  const char *labels[WHEEL_COUNT] = { "frontLeftShock", "frontRightShock", "rearLeftShock", "rearRightShock" };
+
+  while (Serial.available() > 0) {
+    switch (Serial.read()) {
+      case WHEEL_DIAGNOSTICS_SERIAL_COMMAND:
+        printWheelDiagnostics(wheelBank);
+        break;
+      case SHOCK_HISTOGRAM_SERIAL_COMMAND:
+        for (int i = 0; i < WHEEL_COUNT; i++) {
+          printShockHistogram(labels[i], *shocks[i]);
+        }
+        break;
+      case SHOCK_HISTOGRAM_CLEAR_SERIAL_COMMAND:
+        for (int i = 0; i < WHEEL_COUNT; i++) {
+          shocks[i]->histogram.clear();
+        }
+        Serial.println("Shock velocity histograms cleared");
+        break;
+      case SHOCK_CALIBRATION_SERIAL_COMMAND:
+        startShockRestCalibration(shocks);
+        break;
+    }
+  }
+}
 
 void setup() {
   Serial.begin(460800);
 
   delay(100);  // Brief delay for serial to stabilize
 
+#if RUN_WHEEL_BENCHMARK
+  runWheelBenchmark(frontLeftWheelPin);
+#endif
+
+#if RUN_WHEEL_REPLAY
+  runWheelReplay(frontLeftWheelPin);
+#endif
+
+  // Restore each rotor's learned hole spacing
+  frontLeftWheel.loadToothCalibration();
+  frontRightWheel.loadToothCalibration();
+  rearLeftWheel.loadToothCalibration();
+  rearRightWheel.loadToothCalibration();
+
+  // And each tire's learned rolling size
+  tireCalibrator.load();
+
+  // Per-channel ADC correction for the shock displacement tables
+  frontLeftShock.begin();
+  frontRightShock.begin();
+  rearLeftShock.begin();
+  rearRightShock.begin();
+
+  // Shock rest positions from the last calibration
+  loadShockRestReadings(shocks);
+#if CALIBRATE_SHOCKS_AT_BOOT
+  startShockRestCalibration(shocks);
+#endif
+
+  // Start the wheel task before the interrupts so the first edges can already wake it
+#if WHEEL_CAPTURE_INPUT
+  wheelTask.begin(pollWheelCapture, analyzeWheels);
+#else
+  wheelTask.begin(NULL, analyzeWheels);
+#endif
+
   // If the speed sensor detects a metal, it outputs a HIGH. Otherwise, LOW
   // Thus, we want to trigger interrupt on LOW to HIGH transition
-  attachInterrupt(digitalPinToInterrupt(frontLeftWheel.sensorPin), frontLeftISR, RISING);
-  attachInterrupt(digitalPinToInterrupt(frontRightWheel.sensorPin), frontRightISR, RISING);
-  attachInterrupt(digitalPinToInterrupt(rearLeftWheel.sensorPin), rearLeftISR, RISING);
-  attachInterrupt(digitalPinToInterrupt(rearRightWheel.sensorPin), rearRightISR, RISING);
+#if WHEEL_CAPTURE_INPUT
+  wheelCapture.begin(frontLeftWheel, frontRightWheel, rearLeftWheel, rearRightWheel);
+#else
+  wheelGpio.begin(frontLeftWheel, frontRightWheel, rearLeftWheel, rearRightWheel);
+#endif
+
+#if SHOCK_TIMED_SAMPLING
+  shockSampler.begin(frontLeftShockPin, frontRightShockPin, rearLeftShockPin, rearRightShockPin);
+#endif
 
   setupCAN(WHEEL_SPEED, 10);  // sendInterval = 10 means that we will be sending 100 times per second
 
@@ -52,28 +200,60 @@ void setup() {
 }
 
 void loop() {
-  // updateWheelStatus calculates RPM if applicable, checks zero RPM status, and checks for wheelspin/wheel skid
-  frontLeftWheel.updateWheelStatus();
-  frontRightWheel.updateWheelStatus();
-  rearLeftWheel.updateWheelStatus();
-  rearRightWheel.updateWheelStatus();
+  // Wheel processing (RPM, zero RPM, reference speed, wheelspin/skid) happens in wheelTask as each edge arrives
+
+  // Latest IMU, GPS and brake values for the wheel task's reference speed
+  wheelBank.vehicleSpeed().setInputs(accelerationX, gpsVelocity, brakePedalPercentage);
+  spragDetector.setThrottle(gasPedalPercentage);
+  tireCalibrator.setInputs(gyroscopeYaw, accelerationX, gpsVelocity);
+  yawRate.setGyro(gyroscopeYaw);
 
   // Update CAN-Bus variables
-  frontLeftWheelSpeed = frontLeftWheel.wheelSpeedMPH;
-  frontRightWheelSpeed = frontRightWheel.wheelSpeedMPH;
-  rearLeftWheelSpeed = rearLeftWheel.wheelSpeedMPH;
-  rearRightWheelSpeed = rearRightWheel.wheelSpeedMPH;
+  // Speeds are extrapolated to the same instant so the 100 Hz CAN send never publishes a value from the last tooth
+  WheelSnapshot wheels = wheelBank.snapshot();
+  frontLeftWheelSpeed = wheels.speedMPH[FRONT_LEFT];
+  frontRightWheelSpeed = wheels.speedMPH[FRONT_RIGHT];
+  rearLeftWheelSpeed = wheels.speedMPH[REAR_LEFT];
+  rearRightWheelSpeed = wheels.speedMPH[REAR_RIGHT];
+
+  frontLeftWheelState = wheels.state[FRONT_LEFT];
+  frontRightWheelState = wheels.state[FRONT_RIGHT];
+  rearLeftWheelState = wheels.state[REAR_LEFT];
+  rearRightWheelState = wheels.state[REAR_RIGHT];
+
+  frontLeftWheelSlip = wheels.slipRatio[FRONT_LEFT];
+  frontRightWheelSlip = wheels.slipRatio[FRONT_RIGHT];
+  rearLeftWheelSlip = wheels.slipRatio[REAR_LEFT];
+  rearRightWheelSlip = wheels.slipRatio[REAR_RIGHT];
 
-  frontLeftWheelState = frontLeftWheel.wheelState;
-  frontRightWheelState = frontRightWheel.wheelState;
-  rearLeftWheelState = rearLeftWheel.wheelState;
-  rearRightWheelState = rearRightWheel.wheelState;
+  spragEngagement = spragDetector.engagementMask();
+  wheelYawRate = yawRate.wheelYawDPS;
+  yawRateDiscrepancy = yawRate.discrepancyDPS;
+  spragDetector.sendTransitionsCAN();
+
+  // Pulse quality and shock histogram reports over Serial or CAN, only when asked for
+  serviceSerialCommands();
+  serviceWheelDiagnostics(wheelBank);
+  serviceShockHistograms(shocks);
+  serviceShockCalibration(shocks);
 
   // Read shock positions
+#if SHOCK_TIMED_SAMPLING
+  // Work through every sample the shock task has taken since the last pass; the filtered
+  // positions move at SHOCK_SAMPLE_RATE_HZ / SHOCK_FILTER_DECIMATION (100 Hz, the CAN rate)
+  ShockSample shockSample;
+  while (shockSampler.read(shockSample)) {
+    frontLeftShock.addSample(shockSample.reading[FRONT_LEFT]);
+    frontRightShock.addSample(shockSample.reading[FRONT_RIGHT]);
+    rearLeftShock.addSample(shockSample.reading[REAR_LEFT]);
+    rearRightShock.addSample(shockSample.reading[REAR_RIGHT]);
+  }
+#else
   frontLeftShock.getPosition();
   frontRightShock.getPosition();
   rearLeftShock.getPosition();
   rearRightShock.getPosition();
+#endif
 
   frontLeftDisplacement = frontLeftShock.wheelPos;
   frontRightDisplacement = frontRightShock.wheelPos;
@@ -82,16 +262,31 @@ void loop() {
 
   // Print data to serial monitor
   DebugWheelSerial.print("frontLeftWheel_Speed:");
-  DebugWheelSerial.print(frontLeftWheel.wheelSpeedMPH, 2);
+  DebugWheelSerial.print(wheels.speedMPH[FRONT_LEFT], 2);
   DebugWheelSerial.print(",");
   DebugWheelSerial.print("frontRightWheel_Speed:");
-  DebugWheelSerial.print(frontRightWheel.wheelSpeedMPH, 2);
+  DebugWheelSerial.print(wheels.speedMPH[FRONT_RIGHT], 2);
   DebugWheelSerial.print(",");
   DebugWheelSerial.print("rearLeftWheel_Speed:");
-  DebugWheelSerial.print(rearLeftWheel.wheelSpeedMPH, 2);
+  DebugWheelSerial.print(wheels.speedMPH[REAR_LEFT], 2);
   DebugWheelSerial.print(",");
   DebugWheelSerial.print("rearRightWheel_Speed:");
-  DebugWheelSerial.print(rearRightWheel.wheelSpeedMPH, 2);
+  DebugWheelSerial.print(wheels.speedMPH[REAR_RIGHT], 2);
+  DebugWheelSerial.print(",");
+  DebugWheelSerial.print("vehicle_Speed:");
+  DebugWheelSerial.print(wheels.vehicleSpeedMPH, 2);
+  DebugWheelSerial.print(",");
+  DebugWheelSerial.print("frontLeftWheel_Slip:");
+  DebugWheelSerial.print(wheels.slipRatio[FRONT_LEFT], 3);
+  DebugWheelSerial.print(",");
+  DebugWheelSerial.print("frontLeftWheel_State:");
+  DebugWheelSerial.print(wheels.state[FRONT_LEFT]);
+  DebugWheelSerial.print(",");
+  DebugWheelSerial.print("frontLeftWheel_LatencyMicros:");
+  DebugWheelSerial.print(wheelTask.stats.lastLatencyMicros[FRONT_LEFT]);
+  DebugWheelSerial.print(",");
+  DebugWheelSerial.print("frontLeftWheel_MaxLatencyMicros:");
+  DebugWheelSerial.print(wheelTask.stats.maxLatencyMicros[FRONT_LEFT]);
   DebugWheelSerial.println();
 
   DebugShockSerial.print("fl_pos:");
@@ -105,22 +300,8 @@ void loop() {
   DebugShockSerial.print(",");
   DebugShockSerial.print("rr_pos:");
   DebugShockSerial.print(rearRightShock.wheelPos);
+  DebugShockSerial.print(",");
+  DebugShockSerial.print("fl_vel:");
+  DebugShockSerial.print(frontLeftShock.shockVelocity);
   DebugShockSerial.println();
-}
-
-// ISR implementations - now use the debounced handleInterrupt() method
-void frontLeftISR() {
-  frontLeftWheel.handleInterrupt();
-}
-
-void frontRightISR() {
-  frontRightWheel.handleInterrupt();
-}
-
-void rearLeftISR() {
-  rearLeftWheel.handleInterrupt();
-}
-
-void rearRightISR() {
-  rearRightWheel.handleInterrupt();
 }
\ No newline at end of file
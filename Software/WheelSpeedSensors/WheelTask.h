@@ -0,0 +1,179 @@
+/*
+
+  Dedicated FreeRTOS task that processes the wheels as soon as an edge arrives.
+
+  The wheel ISRs set their wheel's bit in this task's notification value. The task sleeps
+  in xTaskNotifyWait() until one does, so a new edge is turned into a published speed
+  right away instead of whenever loop() next gets around to it, and the core is free the
+  rest of the time.
+
+  A stopping wheel is detected by the *absence* of edges (overdue decay and zero timeout),
+  so the task also sets its own wake time from the turning wheels: the earliest
+  nextExpectedMicros, then every WHEEL_TASK_PERIOD_MS while that wheel's speed decays, up to
+  its zero timeout. A pending wheel state change wakes it when it can commit, and it never
+  sleeps longer than WHEEL_TASK_MAX_WAIT_MS while anything is turning, which bounds how late
+  the sprag confirm and the reference speed's IMU integration can run at walking pace. Once
+  every wheel reads zero and the reference speed has settled the task waits on edges alone.
+  Anything that only changes without an edge (the throttle, for the sprag states) is held
+  until the car moves again.
+
+  For every wheel that produced a new estimate the task records the time from the edge's
+  timestamp to the end of the update, which covers interrupt latency, the context switch
+  and the estimator itself.
+
+*/
+
+#pragma once
+
+const uint32_t WHEEL_TASK_PERIOD_MS = 2;     // Wake period while a wheel's overdue speed decays
+const uint32_t WHEEL_TASK_MAX_WAIT_MS = 50;  // Longest the task sleeps without an edge while a wheel turns
+const float WHEEL_TASK_SETTLED_MPH = 0.1;    // Reference speed below which a stopped car needs no more updates
+const UBaseType_t WHEEL_TASK_PRIORITY = 5;  // Above loop() (1) so an edge preempts the shock reads
+const uint32_t WHEEL_TASK_STACK_SIZE = 4096;
+const BaseType_t WHEEL_TASK_CORE = 1;  // Same core the wheel interrupts are attached on
+
+TaskHandle_t wheelTaskHandle = NULL;
+
+// Call from any wheel input ISR after queueing an edge. Returns true if the wheel task
+// should run as soon as the ISR exits (pass to portYIELD_FROM_ISR() or a driver callback's return value)
+bool IRAM_ATTR notifyWheelTaskFromISR(int position) {
+  if (wheelTaskHandle == NULL) return false;
+  BaseType_t woken = pdFALSE;
+  xTaskNotifyFromISR(wheelTaskHandle, 1UL << position, eSetBits, &woken);
+  return woken == pdTRUE;
+}
+
+// Optional work the task does before each update (e.g. checking the capture hardware for missed edges)
+typedef void (*WheelPollFunction)();
+
+// Optional analysis the task runs on every snapshot it publishes (e.g. sprag engagement)
+typedef void (*WheelAnalysisFunction)(const WheelSnapshot &wheels);
+
+struct WheelTaskStats {
+  unsigned long wakeups;   // Passes started by an edge notification
+  unsigned long timeouts;  // Passes started by the task's own wake time
+  unsigned long idleWaits; // Waits with no timeout because the car had stopped
+  unsigned long lastLatencyMicros[WHEEL_COUNT];  // Edge timestamp to published estimate
+  unsigned long maxLatencyMicros[WHEEL_COUNT];
+};
+
+class WheelTask {
+
+private:
+
+  WheelBank &bank;
+  WheelPollFunction poll;
+  WheelAnalysisFunction analysis;
+
+  static void taskCode(void *parameters) {
+    ((WheelTask *)parameters)->run();
+  }
+
+  void run() {
+    Serial.print("Wheel task running on core ");
+    Serial.println(xPortGetCoreID());
+
+    TickType_t waitTicks = portMAX_DELAY;  // Nothing is turning until the first edge
+    for (;;) {
+      uint32_t notifiedWheels = 0;
+      if (xTaskNotifyWait(0, 0xFFFFFFFF, &notifiedWheels, waitTicks) == pdTRUE) {
+        stats.wakeups++;
+      } else {
+        stats.timeouts++;
+      }
+
+      if (poll != NULL) {
+        poll();
+      }
+
+      WheelMicros edgeBefore[WHEEL_COUNT];
+      for (int i = 0; i < WHEEL_COUNT; i++) {
+        edgeBefore[i] = bank.wheel(i).lastReadingMicros;
+      }
+
+      bank.update();
+
+      WheelMicros finished = wheelMicros();
+      for (int i = 0; i < WHEEL_COUNT; i++) {
+        VehicleWheel &wheel = bank.wheel(i);
+        // checkZeroRPM() also moves lastReadingMicros on a timeout, but then there is no estimate to time
+        if (wheel.lastReadingMicros != edgeBefore[i] && wheel.hasSpeedEstimate()) {
+          unsigned long latency = (unsigned long)(finished - wheel.lastReadingMicros);
+          stats.lastLatencyMicros[i] = latency;
+          if (latency > stats.maxLatencyMicros[i]) {
+            stats.maxLatencyMicros[i] = latency;
+          }
+        }
+      }
+
+      // After the latency measurement, which only covers getting the speeds published
+      if (analysis != NULL) {
+        analysis(bank.snapshot());
+      }
+
+      waitTicks = ticksUntilNextWake(wheelMicros());
+      if (waitTicks == portMAX_DELAY) stats.idleWaits++;
+    }
+  }
+
+  // Wait for xTaskNotifyWait() so the task runs again when the bank next needs an update without
+  // an edge, or portMAX_DELAY if only an edge can change anything
+  TickType_t ticksUntilNextWake(WheelMicros now) {
+    bool turning = false;
+    bool pendingState = false;
+    WheelMicros wake = now + WheelMicros(WHEEL_TASK_MAX_WAIT_MS) * 1000;
+
+    for (int i = 0; i < WHEEL_COUNT; i++) {
+      VehicleWheel &wheel = bank.wheel(i);
+
+      // Commits once the enter confirm and the dwell have both passed (see checkWheelState())
+      if (wheel.pendingState != wheel.wheelState) {
+        pendingState = true;
+        WheelMicros commit = std::max(wheel.pendingSinceMicros + WheelMicros(WHEEL_STATE_ENTER_MICROS),
+                                      wheel.stateSinceMicros + WheelMicros(WHEEL_STATE_MIN_DWELL_MICROS));
+        wake = std::min(wake, commit);
+      }
+
+      // Stopped, or never started: nothing happens to this wheel until its next edge
+      if (wheel.isFirstReading || wheel.ignoreNextReading) continue;
+      turning = true;
+
+      WheelMicros due = wheel.isEdgeOverdue(now) ? now + WheelMicros(WHEEL_TASK_PERIOD_MS) * 1000 : wheel.nextExpectedMicros;
+      WheelMicros zeroTimeout = wheel.lastReadingMicros + WheelMicros(ZERO_TIMEOUT_MICROS) + 1;
+      wake = std::min(wake, std::min(due, zeroTimeout));
+    }
+
+    if (!turning && !pendingState && bank.vehicleSpeed().speedMPH < WHEEL_TASK_SETTLED_MPH) {
+      return portMAX_DELAY;
+    }
+
+    // Rounded up; a wait that ends a tick early just costs one extra pass
+    WheelMicros waitMicros = wake - now;
+    if (waitMicros < 1000) waitMicros = 1000;
+    TickType_t ticks = pdMS_TO_TICKS(uint32_t((waitMicros + 999) / 1000));
+    return ticks > 0 ? ticks : 1;
+  }
+
+public:
+
+  WheelTaskStats stats;  // Written only by the task; fine to read from loop()
+
+  WheelTask(WheelBank &wheelBank)
+    : bank(wheelBank), poll(NULL), analysis(NULL) {
+    memset(&stats, 0, sizeof(stats));
+  }
+
+  // Starts processing; from here on only the task may call bank.update() or touch the Wheel objects
+  void begin(WheelPollFunction pollFunction = NULL, WheelAnalysisFunction analysisFunction = NULL) {
+    poll = pollFunction;
+    analysis = analysisFunction;
+    xTaskCreatePinnedToCore(
+      taskCode,
+      "Wheel_Task",
+      WHEEL_TASK_STACK_SIZE,
+      this,
+      WHEEL_TASK_PRIORITY,
+      &wheelTaskHandle,
+      WHEEL_TASK_CORE);
+  }
+};
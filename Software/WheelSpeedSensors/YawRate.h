@@ -0,0 +1,78 @@
+/*
+
+  Yaw rate from the wheel speeds, cross-checked against the DAS gyro.
+
+  Wheels rolling without slip on the same axle differ in speed by exactly yaw rate times
+  track width, so each axle whose wheels are both GOOD gives a kinematic yaw rate and the
+  valid axles are averaged. The front axle is steered, which makes it read slightly low
+  at full lock, but it keeps an estimate going while a rear wheel is spinning.
+
+  The discrepancy is gyroscopeYaw minus the wheel estimate. Near zero the car is rotating
+  the way its wheels are rolling; a growing discrepancy means the body is rotating faster
+  (positive) or slower (negative) than the wheels say, i.e. the tires are sliding
+  sideways. With neither axle usable both outputs are NAN rather than a made-up number.
+
+  Positive yaw is a left turn (right wheels faster). If the DAS uses the other convention
+  flip GYRO_YAW_SIGN rather than the estimate, so CAN consumers see one convention.
+
+*/
+
+#pragma once
+
+// Unmeasured placeholders; replace with the distance between tire contact patch centers
+const float FRONT_TRACK_WIDTH_INCHES = 54;
+const float REAR_TRACK_WIDTH_INCHES = 52;
+const float GYRO_YAW_SIGN = 1;  // gyroscopeYaw is deg/s, positive to the left
+
+const float RADIANS_TO_DEGREES = 57.29578;
+
+class YawRateEstimator {
+
+private:
+
+  volatile float gyroYawDPS;  // Written by loop() from CAN
+
+  // Yaw rate in deg/s from one axle's speed difference
+  static float axleYawDPS(float leftMPH, float rightMPH, float trackInches) {
+    return (rightMPH - leftMPH) * MPH_TO_INCHES_PER_SEC / trackInches * RADIANS_TO_DEGREES;
+  }
+
+public:
+
+  float wheelYawDPS;     // Kinematic estimate from the last update, NAN if no axle was usable
+  float discrepancyDPS;  // Gyro minus wheel estimate, NAN with it
+
+  YawRateEstimator() {
+    gyroYawDPS = 0;
+    wheelYawDPS = NAN;
+    discrepancyDPS = NAN;
+  }
+
+  // Call from loop() with the CAN variable
+  void setGyro(float gyroscopeYaw) {
+    gyroYawDPS = GYRO_YAW_SIGN * gyroscopeYaw;
+  }
+
+  // Call from the wheel task after every WheelBank update
+  void update(const WheelSnapshot &wheels) {
+    float sum = 0;
+    int axles = 0;
+    if (wheels.state[FRONT_LEFT] == GOOD && wheels.state[FRONT_RIGHT] == GOOD) {
+      sum += axleYawDPS(wheels.speedMPH[FRONT_LEFT], wheels.speedMPH[FRONT_RIGHT], FRONT_TRACK_WIDTH_INCHES);
+      axles++;
+    }
+    if (wheels.state[REAR_LEFT] == GOOD && wheels.state[REAR_RIGHT] == GOOD) {
+      sum += axleYawDPS(wheels.speedMPH[REAR_LEFT], wheels.speedMPH[REAR_RIGHT], REAR_TRACK_WIDTH_INCHES);
+      axles++;
+    }
+
+    if (axles == 0) {
+      wheelYawDPS = NAN;
+      discrepancyDPS = NAN;
+      return;
+    }
+
+    wheelYawDPS = sum / axles;
+    discrepancyDPS = gyroYawDPS - wheelYawDPS;
+  }
+};
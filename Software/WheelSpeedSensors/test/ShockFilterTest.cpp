@@ -0,0 +1,95 @@
+// Checks ShockFilter's DC gain and frequency response against what ShockFilter.h promises, and
+// that the four channels fit the per-sample budget (the same benchmark RUN_WHEEL_BENCHMARK runs)
+
+#include <Arduino.h>
+#include "Wheel.h"
+#include "ShockFilter.h"
+#include "WheelBenchmark.h"
+
+const int32_t MID_SCALE = 2048;
+const float TEST_AMPLITUDE = 1000;  // Counts
+const int SETTLE_OUTPUTS = 50;      // Well past the filter's ~60 ms delay
+const int MEASURE_OUTPUTS = 400;
+
+const float MAX_PASSBAND_LOSS_DB = 0.6;   // Up to 20 Hz
+const float MIN_STOPBAND_LOSS_DB = 50;    // From 50 Hz
+const float MAX_BUDGET_PERCENT = 1;       // Four channels, per sample period
+
+int failures = 0;
+
+// Gain in dB of a sine at frequencyHz, measured as the RMS of the output around mid-scale so
+// anything that aliases onto DC still counts
+float responseDB(float frequencyHz) {
+  ShockFilter filter;
+  double squaredSum = 0;
+  int outputs = 0;
+  for (long i = 0; outputs < SETTLE_OUTPUTS + MEASURE_OUTPUTS; i++) {
+    int reading = int(lround(MID_SCALE + TEST_AMPLITUDE * sin(2 * M_PI * frequencyHz * i / SHOCK_SAMPLE_RATE_HZ)));
+    int32_t outputQ4;
+    if (!filter.add(reading, outputQ4)) continue;
+    if (++outputs <= SETTLE_OUTPUTS) continue;
+    double deviation = double(outputQ4) / (1 << SHOCK_FILTER_FRACTION_BITS) - MID_SCALE;
+    squaredSum += deviation * deviation;
+  }
+  double outputRms = sqrt(squaredSum / MEASURE_OUTPUTS);
+  return float(20 * log10(outputRms / (TEST_AMPLITUDE / sqrt(2.0))));
+}
+
+void testDCGain() {
+  const int readings[] = { 0, 1, 48, 2048, 4010, 4095 };
+  for (int reading : readings) {
+    ShockFilter filter;
+    int32_t outputQ4 = -1;
+    for (int i = 0; i < 1000; i++) {
+      filter.add(reading, outputQ4);
+    }
+    if (outputQ4 != reading << SHOCK_FILTER_FRACTION_BITS) {
+      Serial.print("FAIL: DC gain at reading ");
+      Serial.println(reading);
+      failures++;
+    }
+  }
+}
+
+void printResponse(float frequencyHz, float gainDB, bool passed) {
+  char line[60];
+  snprintf(line, sizeof(line), "  %5.0f Hz  %7.1f dB%s", frequencyHz, gainDB, passed ? "" : "  FAIL");
+  Serial.println(line);
+  if (!passed) failures++;
+}
+
+void testResponse() {
+  const float passband[] = { 1, 5, 10, 15, 20 };
+  const float stopband[] = { 50, 60, 75, 100, 150, 200, 250, 333, 400, 499 };
+
+  Serial.println("Shock filter response:");
+  for (float frequency : passband) {
+    float gain = responseDB(frequency);
+    printResponse(frequency, gain, fabsf(gain) <= MAX_PASSBAND_LOSS_DB);
+  }
+  for (float frequency : stopband) {
+    float gain = responseDB(frequency);
+    printResponse(frequency, gain, gain <= -MIN_STOPBAND_LOSS_DB);
+  }
+}
+
+// Host cycles are far cheaper than the ESP32's, so this only catches gross regressions; the
+// on-car benchmark is the real budget check
+void testBudget() {
+  uint32_t cycles = benchmarkShockFilter();
+  float percent = 4 * cycles * 100.0 / (ESP.getCpuFreqMHz() * 1000000 / SHOCK_SAMPLE_RATE_HZ);
+  char line[120];
+  snprintf(line, sizeof(line), "Shock filter: %u cycles (%u ns) per sample, 4 channels %.3f%% of a period%s",
+           (unsigned)cycles, (unsigned)(cycles * 1000 / ESP.getCpuFreqMHz()), percent, percent <= MAX_BUDGET_PERCENT ? "" : "  FAIL");
+  Serial.println(line);
+  if (percent > MAX_BUDGET_PERCENT) failures++;
+}
+
+int main() {
+  testDCGain();
+  testResponse();
+  testBudget();
+
+  Serial.println(failures == 0 ? "Shock filter tests passed" : "Shock filter tests FAILED");
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,65 @@
+// Checks Shock's rest calibration: a still shock with raw ADC noise well past
+// SHOCK_REST_CAL_MAX_SPREAD peak to peak is accepted at its mean, and one that moves is rejected
+
+#include <Arduino.h>
+#include <random>
+#include "Shock.h"
+
+const int REST_READING = 2300;
+const int OLD_REST_READING = 2000;
+const float NOISE_COUNTS = 15;     // Standard deviation, roughly what ADC2 shows on the car
+const int MOVE_COUNTS = 3 * SHOCK_REST_CAL_MAX_SPREAD;
+
+int failures = 0;
+
+// Runs one calibration window of noisy readings, stepping by stepCounts halfway through
+ShockRestCalibration calibrate(Shock &shock, int stepCounts, int &rawSpread) {
+  std::mt19937 generator(1);
+  std::normal_distribution<float> noise(0, NOISE_COUNTS);
+  int minReading = 4095;
+  int maxReading = 0;
+  shock.startRestCalibration();
+  for (int i = 0; i < SHOCK_REST_CAL_SAMPLES; i++) {
+    int reading = int(lround(REST_READING + noise(generator))) + (i >= SHOCK_REST_CAL_SAMPLES / 2 ? stepCounts : 0);
+    if (reading < minReading) minReading = reading;
+    if (reading > maxReading) maxReading = reading;
+    shock.addSample(reading);
+  }
+  rawSpread = maxReading - minReading;
+  return shock.restCalibration;
+}
+
+void check(bool passed, const char *name) {
+  Serial.print(passed ? "  pass: " : "  FAIL: ");
+  Serial.println(name);
+  if (!passed) failures++;
+}
+
+void testStill() {
+  Shock shock(34, true, OLD_REST_READING);
+  int rawSpread;
+  ShockRestCalibration result = calibrate(shock, 0, rawSpread);
+  Serial.print("Still shock, raw spread ");
+  Serial.print(rawSpread);
+  Serial.println(" counts:");
+  check(rawSpread > SHOCK_REST_CAL_MAX_SPREAD, "raw noise exceeds the spread limit");
+  check(result == REST_CAL_DONE, "calibration accepted");
+  check(abs(shock.getRestReading() - REST_READING) <= 2, "rest reading is the mean");
+}
+
+void testMoved() {
+  Shock shock(34, true, OLD_REST_READING);
+  int rawSpread;
+  ShockRestCalibration result = calibrate(shock, MOVE_COUNTS, rawSpread);
+  Serial.println("Shock moved during the window:");
+  check(result == REST_CAL_FAILED, "calibration rejected");
+  check(shock.getRestReading() == OLD_REST_READING, "rest reading unchanged");
+}
+
+int main() {
+  testStill();
+  testMoved();
+
+  Serial.println(failures == 0 ? "Shock rest calibration tests passed" : "Shock rest calibration tests FAILED");
+  return failures == 0 ? 0 : 1;
+}
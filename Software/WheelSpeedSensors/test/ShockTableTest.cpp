@@ -0,0 +1,88 @@
+// Checks Shock's displacement table: before begin() it reproduces the old linear conversion,
+// (rest - reading) / analogValPerInch / motion ratio, within one table unit at every reading; after
+// begin() (the bent curve the esp_adc_cal mock characterizes) wheel travel only ever falls as the
+// reading rises, and filter ringing past either rail is clamped to the table ends
+
+#include <Arduino.h>
+#include "Shock.h"
+
+const int FRONT_PIN = 34;
+const int REAR_PIN = 35;
+const float TABLE_UNIT_INCHES = 1 / SHOCK_TABLE_UNITS_PER_INCH;
+const int RING_STEPS = 20;  // Full-scale steps fed through the filter to make it ring past the rails
+
+int failures = 0;
+
+void check(bool passed, const char *name) {
+  Serial.print(passed ? "  pass: " : "  FAIL: ");
+  Serial.println(name);
+  if (!passed) failures++;
+}
+
+float positionAt(Shock &shock, int reading) {
+  mockSetAnalogRead(reading);
+  shock.getPosition();
+  return shock.wheelPos;
+}
+
+// Largest difference from the old conversion over every raw reading
+float worstLinearError(Shock &shock, float motionRatio) {
+  float worst = 0;
+  for (int reading = 0; reading <= 4095; reading++) {
+    float oldInches = float(shock.getRestReading() - reading) / analogValPerInch / motionRatio;
+    float error = fabsf(positionAt(shock, reading) - oldInches);
+    if (error > worst) worst = error;
+  }
+  return worst;
+}
+
+void testUncorrected() {
+  Shock front(FRONT_PIN, true, frontLeftShock_restReading);
+  Shock rear(REAR_PIN, false, rearLeftShock_restReading);
+  float frontError = worstLinearError(front, frontMotionRatio);
+  float rearError = worstLinearError(rear, rearMotionRatio);
+
+  char line[100];
+  snprintf(line, sizeof(line), "Before begin(), worst difference from the linear conversion %.5f\" front, %.5f\" rear:", frontError, rearError);
+  Serial.println(line);
+  check(frontError <= TABLE_UNIT_INCHES, "front within one table unit");
+  check(rearError <= TABLE_UNIT_INCHES, "rear within one table unit");
+}
+
+void testCorrected() {
+  Shock shock(FRONT_PIN, true, frontLeftShock_restReading);
+  shock.begin();
+  Serial.println("After begin():");
+
+  bool monotonic = true;
+  float previous = positionAt(shock, 0);
+  for (int reading = 1; reading <= 4095; reading++) {
+    float position = positionAt(shock, reading);
+    if (position > previous) monotonic = false;
+    previous = position;
+  }
+  float droop = positionAt(shock, 4095);
+  float bump = positionAt(shock, 0);
+  check(monotonic, "wheel travel never rises with the reading");
+  check(fabsf(positionAt(shock, frontLeftShock_restReading)) < TABLE_UNIT_INCHES, "zero at the rest reading");
+
+  // Square wave between the rails; the filter overshoots both by a few hundred Q4 counts
+  float lowest = bump;
+  float highest = droop;
+  for (int i = 0; i < RING_STEPS * SHOCK_FILTER_DECIMATION * 64; i++) {
+    int reading = (i / (SHOCK_FILTER_DECIMATION * 32)) % 2 ? 4095 : 0;
+    if (shock.addSample(reading)) {
+      lowest = std::min(lowest, shock.wheelPos);
+      highest = std::max(highest, shock.wheelPos);
+    }
+  }
+  check(lowest >= droop && highest <= bump, "ringing past the rails stays at the table ends");
+}
+
+int main() {
+  testUncorrected();
+  testCorrected();
+
+  Serial.println(failures == 0 ? "Shock table tests passed" : "Shock table tests FAILED");
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,180 @@
+// Checks SpragDetector: under throttle a wheel engages inside the engage band of the slowest wheel
+// and only releases outside the wider release band, a new state has to hold for
+// SPRAG_CONFIRM_MICROS and is stamped with when it first appeared, and the queued transitions go
+// out on spragTransition_ID in order, with overflow counted rather than blocking the wheel task
+
+#include <Arduino.h>
+#include <vector>
+#include "Wheel.h"
+#include "VehicleSpeed.h"
+#include "WheelBank.h"
+
+// Stand-ins for the two BajaCAN.h names SpragClutch.h sends through
+const int spragTransition_ID = 0x28;
+
+struct SentFrame {
+  uint32_t id;
+  uint8_t index;
+  uint8_t field;
+  int value;
+};
+std::vector<SentFrame> sentFrames;
+
+bool sendCANIndexedInt(uint32_t id, uint8_t index, uint8_t field, int value) {
+  SentFrame frame = { id, index, field, value };
+  sentFrames.push_back(frame);
+  return true;
+}
+
+#include "SpragClutch.h"
+
+const WheelMicros STEP_MICROS = 1000;
+const float SLOWEST_MPH = 20;  // Bands of 0.6 and 1.2 MPH at this speed
+const int DRIVING_PERCENT = SPRAG_THROTTLE_PERCENT + 20;
+
+int failures = 0;
+
+void check(bool passed, const char *name) {
+  Serial.print(passed ? "  pass: " : "  FAIL: ");
+  Serial.println(name);
+  if (!passed) failures++;
+}
+
+struct SpragRig {
+  SpragDetector detector;
+  WheelSnapshot wheels;
+
+  SpragRig() {
+    memset(&wheels, 0, sizeof(wheels));
+    wheels.sampleMicros = 1000000;
+    detector.setThrottle(DRIVING_PERCENT);
+    sentFrames.clear();
+  }
+
+  // Rear right (the one under test) at rearRightMPH, the others at SLOWEST_MPH, for 'micros'.
+  // Returns how long after the start rear right changed state, or -1
+  WheelMicros hold(float rearRightMPH, WheelMicros micros) {
+    bool before = detector.engaged[REAR_RIGHT];
+    WheelMicros start = wheels.sampleMicros;
+    WheelMicros changed = -1;
+    for (WheelMicros t = 0; t < micros; t += STEP_MICROS) {
+      for (int i = 0; i < WHEEL_COUNT; i++) wheels.speedMPH[i] = SLOWEST_MPH;
+      wheels.speedMPH[REAR_RIGHT] = rearRightMPH;
+      detector.update(wheels);
+      if (changed < 0 && detector.engaged[REAR_RIGHT] != before) changed = wheels.sampleMicros - start;
+      wheels.sampleMicros += STEP_MICROS;
+    }
+    return changed;
+  }
+};
+
+void testBands() {
+  Serial.println("Engage and release bands:");
+  float engageBand = SLOWEST_MPH * SPRAG_ENGAGE_BAND_FRACTION;
+  float releaseBand = SLOWEST_MPH * SPRAG_RELEASE_BAND_FRACTION;
+  float betweenMPH = SLOWEST_MPH + (engageBand + releaseBand) / 2;
+
+  SpragRig rig;
+  rig.hold(SLOWEST_MPH + releaseBand + 1, 100000);
+  check(!rig.detector.engaged[REAR_RIGHT], "a wheel well above the slowest is overrunning");
+  check(rig.detector.engaged[FRONT_LEFT], "the slowest wheels are engaged");
+
+  rig.hold(betweenMPH, 500000);
+  check(!rig.detector.engaged[REAR_RIGHT], "between the bands doesn't engage an overrunning wheel");
+  rig.hold(SLOWEST_MPH + engageBand / 2, 100000);
+  check(rig.detector.engaged[REAR_RIGHT], "inside the engage band engages it");
+  rig.hold(betweenMPH, 500000);
+  check(rig.detector.engaged[REAR_RIGHT], "between the bands doesn't release an engaged wheel");
+  rig.hold(SLOWEST_MPH + releaseBand + 0.2, 100000);
+  check(!rig.detector.engaged[REAR_RIGHT], "past the release band releases it");
+
+  // At low speed the bands bottom out at SPRAG_BAND_MIN_MPH instead of shrinking to nothing
+  SpragRig slow;
+  for (int i = 0; i < WHEEL_COUNT; i++) slow.wheels.speedMPH[i] = 5;
+  slow.wheels.speedMPH[REAR_RIGHT] = 5 + SPRAG_BAND_MIN_MPH * 0.8;
+  for (int i = 0; i < 100; i++) {
+    slow.detector.update(slow.wheels);
+    slow.wheels.sampleMicros += STEP_MICROS;
+  }
+  check(slow.detector.engaged[REAR_RIGHT], "engage band floor at low speed");
+
+  // Under throttle below SPRAG_MIN_SPEED_MPH the speeds are too coarse; states are held
+  rig.hold(SLOWEST_MPH, 100000);
+  check(rig.detector.engagementMask() == 0xF, "every wheel engaged at the same speed");
+  for (int i = 0; i < 100; i++) {
+    for (int w = 0; w < WHEEL_COUNT; w++) rig.wheels.speedMPH[w] = SPRAG_MIN_SPEED_MPH / 2;
+    rig.wheels.speedMPH[REAR_RIGHT] = SPRAG_MIN_SPEED_MPH * 3;
+    rig.detector.update(rig.wheels);
+    rig.wheels.sampleMicros += STEP_MICROS;
+  }
+  check(rig.detector.engagementMask() == 0xF, "states held below SPRAG_MIN_SPEED_MPH");
+
+  // Off throttle nothing is driven, so everything overruns
+  rig.detector.setThrottle(0);
+  rig.hold(SLOWEST_MPH, 100000);
+  check(rig.detector.engagementMask() == 0, "every wheel releases off throttle");
+}
+
+void testConfirm() {
+  Serial.println("Confirm:");
+  float overrunMPH = SLOWEST_MPH + 5;
+
+  SpragRig rig;
+  rig.hold(overrunMPH, 100000);
+  check(rig.hold(SLOWEST_MPH, SPRAG_CONFIRM_MICROS - STEP_MICROS) < 0, "not engaged before SPRAG_CONFIRM_MICROS");
+  rig.hold(overrunMPH, 100000);
+
+  WheelMicros appeared = rig.wheels.sampleMicros;
+  check(rig.hold(SLOWEST_MPH, 100000) == WheelMicros(SPRAG_CONFIRM_MICROS), "engaged after SPRAG_CONFIRM_MICROS");
+  check(rig.detector.lastTransitionMicros[REAR_RIGHT] == appeared, "stamped with when it first looked engaged");
+  check(rig.detector.engagements[REAR_RIGHT] == 1, "one engagement counted");
+}
+
+void testQueue() {
+  Serial.println("Transition queue:");
+  float overrunMPH = SLOWEST_MPH + 5;
+  const int cycles = 5;
+
+  SpragRig rig;
+  rig.hold(SLOWEST_MPH, 100000);
+  rig.detector.sendTransitionsCAN();
+  size_t settled = sentFrames.size();  // The four wheels engaging from the start
+
+  std::vector<WheelMicros> expected;
+  for (int i = 0; i < cycles; i++) {
+    expected.push_back(rig.wheels.sampleMicros);
+    rig.hold(overrunMPH, 50000);
+    expected.push_back(rig.wheels.sampleMicros);
+    rig.hold(SLOWEST_MPH, 50000);
+  }
+  rig.detector.sendTransitionsCAN();
+
+  bool framesMatch = sentFrames.size() == settled + 2 * cycles;
+  for (int i = 0; framesMatch && i < 2 * cycles; i++) {
+    const SentFrame &frame = sentFrames[settled + i];
+    framesMatch = frame.id == 0x28 && frame.index == REAR_RIGHT && frame.field == (i % 2 ? 1 : 0)
+                  && frame.value == int(expected[i] / 1000);
+  }
+  check(framesMatch, "each transition sent on 0x28 in order with wheel, state and first-seen time");
+  check(rig.detector.droppedTransitions == 0, "nothing dropped");
+
+  // loop() stalls: the queue fills, the rest are counted, and the task never waits on it
+  sentFrames.clear();
+  const int transitions = SPRAG_TRANSITION_QUEUE_SIZE + 8;
+  for (int i = 0; i < transitions / 2; i++) {
+    rig.hold(overrunMPH, 50000);
+    rig.hold(SLOWEST_MPH, 50000);
+  }
+  rig.detector.sendTransitionsCAN();
+  check(sentFrames.size() == SPRAG_TRANSITION_QUEUE_SIZE, "a full queue sends what it holds");
+  check(rig.detector.droppedTransitions == transitions - SPRAG_TRANSITION_QUEUE_SIZE, "and counts the rest as dropped");
+}
+
+int main() {
+  testBands();
+  testConfirm();
+  testQueue();
+
+  Serial.println(failures == 0 ? "Sprag clutch tests passed" : "Sprag clutch tests FAILED");
+  return failures == 0 ? 0 : 1;
+}
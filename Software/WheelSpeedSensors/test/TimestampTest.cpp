@@ -0,0 +1,85 @@
+// Coverage for the 64-bit wheel time base: CaptureClock's extension of the 32-bit, 80 MHz
+// capture count, and the wheel pipeline running past the old 32-bit micros() wrap and hours in
+
+#include <Arduino.h>
+#include "Wheel.h"
+#include "VehicleSpeed.h"
+#include "WheelBank.h"
+#include "WheelTask.h"
+#include "WheelCapture.h"
+
+int failures = 0;
+
+void check(bool condition, const char *what) {
+  if (!condition) {
+    Serial.print("FAIL: ");
+    Serial.println(what);
+    failures++;
+  }
+}
+
+// Edges every 12345.678 us for long enough that the capture count wraps twice; the sub-microsecond
+// remainder has to carry so the timestamps never drift from the true edge times
+void testCaptureClockWrapAndRemainder() {
+  CaptureClock clock;
+  const WheelMicros anchorMicros = 0xFFFFFFFFLL - 1000000;  // Right before the old micros() wrap
+  const uint32_t anchorTicks = 0xFFFFFFFF - 80000000;       // One second before the capture count wraps
+  const double periodTicks = 12345.678 * CAPTURE_TICKS_PER_MICRO;
+  const int edges = 2 * 4348 * 100;  // ~107 s, past two capture count wraps
+
+  check(clock.toMicros(anchorTicks, anchorMicros) == anchorMicros, "first capture anchors to the ISR time");
+
+  long worstError = 0;
+  for (int i = 1; i <= edges; i++) {
+    uint64_t ticks = uint64_t(i * periodTicks);
+    WheelMicros trueMicros = anchorMicros + WheelMicros(ticks / CAPTURE_TICKS_PER_MICRO);
+    WheelMicros stamped = clock.toMicros(uint32_t(anchorTicks + ticks), trueMicros + 7);  // ISR runs a little later
+    long error = long(stamped - trueMicros);
+    if (labs(error) > worstError) worstError = labs(error);
+  }
+  check(worstError == 0, "capture timestamps stay exact across capture count wraps");
+}
+
+// A gap longer than CAPTURE_REANCHOR_MICROS can hide any number of 53 s wraps, so the clock re-anchors
+void testCaptureClockReanchor() {
+  CaptureClock clock;
+  clock.toMicros(1000, 5000000);
+  clock.toMicros(1000 + 80 * 500000, 5500000);
+
+  WheelMicros late = 5500000 + CAPTURE_REANCHOR_MICROS + 60000000;
+  check(clock.toMicros(12345, late) == late, "long gap re-anchors to the ISR time");
+  check(clock.toMicros(12345 + 80 * 100, late + 150) == late + 100, "edges after re-anchoring use the capture count again");
+}
+
+// Constant speed through wheelMicros() (the GPIO path) starting at a given time, checked at the end
+void checkWheelAt(WheelMicros startMicros, const char *what) {
+  VehicleWheel wheel(19);
+  wheel.persistToothCalibration = false;
+
+  const float mph = 25;
+  const WheelMicros toothMicros = WheelMicros(60000000.0 / (mph * mphToRpmFactor) / VehicleWheel::TARGETS);
+  mockMicros = startMicros;
+  for (int i = 0; i < 200; i++) {
+    mockMicros += toothMicros;
+    wheel.handleInterrupt();
+    wheel.calculateRPM();
+    wheel.checkZeroRPM();
+  }
+  check(fabsf(wheel.predictSpeedMPH(mockMicros) - mph) < 0.05, what);
+
+  // And the zero timeout still fires
+  mockMicros += ZERO_TIMEOUT_MICROS + 1;
+  wheel.checkZeroRPM();
+  check(wheel.predictSpeedMPH(mockMicros) == 0, "wheel times out to zero");
+}
+
+int main() {
+  testCaptureClockWrapAndRemainder();
+  testCaptureClockReanchor();
+  checkWheelAt(0xFFFFFFFFLL - 2000000, "speed across the old 32-bit micros() wrap");
+  checkWheelAt(4LL * 3600 * 1000000, "speed four hours in");
+  checkWheelAt(30LL * 24 * 3600 * 1000000, "speed thirty days in");
+
+  Serial.println(failures == 0 ? "Timestamp tests passed" : "Timestamp tests FAILED");
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,189 @@
+// Checks TireCalibrator against a car whose four tires are off their nominal size by known
+// amounts: only steady straight-line driving with GPS is used, a correction is applied once per
+// TIRE_CAL_BATCH_SAMPLES samples, limited to TIRE_CAL_MAX_STEP and clamped to 0.9-1.1, and the
+// scales only go to (mocked) NVS once every wheel has stopped
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include "Wheel.h"
+#include "VehicleSpeed.h"
+#include "WheelBank.h"
+#include "TireCalibration.h"
+
+const int GPS_MPS = 9;
+const float TRUE_MPH = GPS_MPS * GPS_VELOCITY_TO_MPH;  // Driven at exactly a whole GPS step
+
+// Effective rolling diameter / nominal for each wheel; the scale each should learn (clamped)
+const float TIRE_SIZES[WHEEL_COUNT] = { 1.02, 1.08, 1.3, 0.8 };
+
+int failures = 0;
+
+void check(bool passed, const char *name) {
+  Serial.print(passed ? "  pass: " : "  FAIL: ");
+  Serial.println(name);
+  if (!passed) failures++;
+}
+
+struct TireRig {
+  VehicleWheel frontLeft, frontRight, rearLeft, rearRight;
+  WheelBank bank;
+  TireCalibrator calibrator;
+  WheelSnapshot wheels;
+  float trueMPH;
+
+  TireRig() : frontLeft(19), frontRight(17), rearLeft(18), rearRight(16),
+              bank(frontLeft, frontRight, rearLeft, rearRight), calibrator(bank), trueMPH(TRUE_MPH) {
+    memset(&wheels, 0, sizeof(wheels));
+    wheels.sampleMicros = 1000000;
+    calibrator.setInputs(0, 0, GPS_MPS);
+  }
+
+  // Publishes 'samples' snapshots TIRE_CAL_SAMPLE_MICROS apart with the car at trueMPH; each
+  // wheel reads its nominal speed scaled by its current tireScale, as WheelBank publishes it
+  void drive(unsigned long samples) {
+    for (unsigned long s = 0; s < samples; s++) {
+      for (int i = 0; i < WHEEL_COUNT; i++) {
+        wheels.speedMPH[i] = trueMPH / TIRE_SIZES[i] * bank.wheel(i).tireScale;
+      }
+      calibrator.update(wheels);
+      wheels.sampleMicros += TIRE_CAL_SAMPLE_MICROS;
+    }
+  }
+
+  // One snapshot with the given wheels at zero and the rest still rolling
+  void sample(const bool *stoppedWheels) {
+    for (int i = 0; i < WHEEL_COUNT; i++) {
+      wheels.speedMPH[i] = stoppedWheels[i] ? 0 : 5;
+    }
+    calibrator.update(wheels);
+    wheels.sampleMicros += TIRE_CAL_SAMPLE_MICROS;
+  }
+
+  bool unchanged() {
+    for (int i = 0; i < WHEEL_COUNT; i++) {
+      if (bank.wheel(i).tireScale != 1.0f) return false;
+    }
+    return true;
+  }
+};
+
+bool scalesSaved(TireRig &rig) {
+  Preferences preferences;
+  preferences.begin("wheelcal", true);
+  bool saved = true;
+  for (int i = 0; i < WHEEL_COUNT; i++) {
+    char key[16];
+    snprintf(key, sizeof(key), "tire%d", rig.bank.wheel(i).sensorPin);
+    saved = saved && preferences.isKey(key);
+  }
+  preferences.end();
+  return saved;
+}
+
+void testSteadyGate() {
+  Serial.println("Steady gate:");
+  const float accelerationMPS2 = 1.5 * TIRE_CAL_MAX_ACCEL_MPHPS / IMU_ACCEL_TO_MPHPS;
+
+  TireRig turning;
+  turning.calibrator.setInputs(2 * TIRE_CAL_MAX_YAW_DPS, 0, GPS_MPS);
+  turning.drive(2 * TIRE_CAL_BATCH_SAMPLES);
+  check(turning.unchanged(), "nothing learned while turning");
+
+  TireRig accelerating;
+  accelerating.calibrator.setInputs(0, accelerationMPS2, GPS_MPS);
+  accelerating.drive(2 * TIRE_CAL_BATCH_SAMPLES);
+  check(accelerating.unchanged(), "or accelerating");
+
+  TireRig slow;
+  int slowMPS = int(TIRE_CAL_MIN_GPS_MPH / GPS_VELOCITY_TO_MPH);
+  slow.trueMPH = slowMPS * GPS_VELOCITY_TO_MPH;
+  slow.calibrator.setInputs(0, 0, slowMPS);
+  slow.drive(2 * TIRE_CAL_BATCH_SAMPLES);
+  check(slow.unchanged(), "or below TIRE_CAL_MIN_GPS_MPH");
+
+  TireRig noFix;
+  noFix.calibrator.setInputs(0, 0, 0);
+  noFix.drive(2 * TIRE_CAL_BATCH_SAMPLES);
+  check(noFix.unchanged(), "or without GPS");
+
+  // A wheel spinning well past GPS means the car isn't rolling freely
+  TireRig spinning;
+  for (unsigned long s = 0; s < 2 * TIRE_CAL_BATCH_SAMPLES; s++) {
+    for (int i = 0; i < WHEEL_COUNT; i++) spinning.wheels.speedMPH[i] = TRUE_MPH;
+    spinning.wheels.speedMPH[REAR_LEFT] = TRUE_MPH * (1 + 2 * TIRE_CAL_MAX_GPS_ERROR) + GPS_VELOCITY_TO_MPH;
+    spinning.calibrator.update(spinning.wheels);
+    spinning.wheels.sampleMicros += TIRE_CAL_SAMPLE_MICROS;
+  }
+  check(spinning.unchanged(), "or with a wheel far from GPS");
+
+  // Snapshots closer together than TIRE_CAL_SAMPLE_MICROS count once
+  TireRig fast;
+  for (unsigned long s = 0; s < 4 * TIRE_CAL_BATCH_SAMPLES; s++) {
+    for (int i = 0; i < WHEEL_COUNT; i++) fast.wheels.speedMPH[i] = TRUE_MPH / TIRE_SIZES[i];
+    fast.calibrator.update(fast.wheels);
+    fast.wheels.sampleMicros += TIRE_CAL_SAMPLE_MICROS / 5;
+  }
+  check(fast.unchanged(), "faster updates don't fill a batch sooner");
+}
+
+void testBatch() {
+  Serial.println("Batches:");
+  TireRig rig;
+  rig.drive(TIRE_CAL_BATCH_SAMPLES - 1);
+  check(rig.unchanged(), "nothing applied before TIRE_CAL_BATCH_SAMPLES");
+
+  rig.drive(1);
+  float expected = 1 + TIRE_CAL_GAIN * (TIRE_SIZES[FRONT_LEFT] - 1);
+  check(fabsf(rig.bank.wheel(FRONT_LEFT).tireScale - expected) < 1e-4, "a small error is corrected by TIRE_CAL_GAIN of it");
+  check(fabsf(rig.bank.wheel(FRONT_RIGHT).tireScale - (1 + TIRE_CAL_MAX_STEP)) < 1e-4, "a large one by at most TIRE_CAL_MAX_STEP");
+  check(fabsf(rig.bank.wheel(REAR_RIGHT).tireScale - (1 - TIRE_CAL_MAX_STEP)) < 1e-4, "in either direction");
+
+  rig.drive(40 * TIRE_CAL_BATCH_SAMPLES);
+  char line[100];
+  snprintf(line, sizeof(line), "  after 41 batches: %.4f %.4f %.4f %.4f", rig.frontLeft.tireScale, rig.frontRight.tireScale,
+           rig.rearLeft.tireScale, rig.rearRight.tireScale);
+  Serial.println(line);
+  check(fabsf(rig.frontLeft.tireScale - TIRE_SIZES[FRONT_LEFT]) < 0.002, "converges on the tire size");
+  check(fabsf(rig.frontRight.tireScale - TIRE_SIZES[FRONT_RIGHT]) < 0.002, "including past several steps");
+  check(rig.rearLeft.tireScale == TIRE_CAL_MAX_SCALE, "clamped at TIRE_CAL_MAX_SCALE");
+  check(rig.rearRight.tireScale == TIRE_CAL_MIN_SCALE, "clamped at TIRE_CAL_MIN_SCALE");
+}
+
+void testSave() {
+  Serial.println("Saving:");
+  mockClearPreferences();
+  TireRig rig;
+  rig.drive(TIRE_CAL_BATCH_SAMPLES);
+  check(!scalesSaved(rig), "not saved while driving");
+
+  const bool oneStopped[WHEEL_COUNT] = { true, false, false, false };
+  const bool threeStopped[WHEEL_COUNT] = { true, true, true, false };
+  const bool allStopped[WHEEL_COUNT] = { true, true, true, true };
+  rig.sample(oneStopped);
+  rig.sample(threeStopped);
+  check(!scalesSaved(rig), "not saved while any wheel turns");
+  rig.sample(allStopped);
+  check(scalesSaved(rig), "saved once every wheel reads zero");
+
+  TireRig restarted;
+  restarted.calibrator.load();
+  bool restored = true;
+  for (int i = 0; i < WHEEL_COUNT; i++) {
+    restored = restored && restarted.bank.wheel(i).tireScale == rig.bank.wheel(i).tireScale;
+  }
+  check(restored, "load() restores the saved scales");
+
+  // Nothing new learned since: a second stop doesn't write again
+  mockClearPreferences();
+  rig.sample(allStopped);
+  check(!scalesSaved(rig), "no write without a change");
+}
+
+int main() {
+  testSteadyGate();
+  testBatch();
+  testSave();
+
+  Serial.println(failures == 0 ? "Tire calibration tests passed" : "Tire calibration tests FAILED");
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,140 @@
+// Checks the per-tooth spacing calibration: a rotor with unevenly drilled holes puts a ripple
+// repeating every revolution on the speed until the table has learned it, the learned table
+// finds its phase again after the wheel stops and restarts on another hole, and WheelBank only
+// saves the tables once every wheel has stopped
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include "Wheel.h"
+#include "VehicleSpeed.h"
+#include "WheelBank.h"
+
+const float TEST_MPH = 20;
+const float HOLE_ERRORS[VehicleWheel::TARGETS] = { 0.03, -0.02, 0.01, -0.02 };  // Fraction of a nominal spacing, summing to zero
+
+const int UNLEARNED_REVOLUTIONS = 20;
+const int LEARNING_REVOLUTIONS = 400;   // ~8 time constants of TOOTH_CAL_GAIN
+const int RELOCK_REVOLUTIONS = 20;
+
+const float MIN_UNLEARNED_RIPPLE_MPH = 0.15;
+const float MAX_LEARNED_RIPPLE_MPH = 0.05;
+
+int failures = 0;
+
+void check(bool condition, const char *what) {
+  Serial.print(condition ? "  pass: " : "  FAIL: ");
+  Serial.println(what);
+  if (!condition) failures++;
+}
+
+// Edge times of a rotor turning at TEST_MPH with HOLE_ERRORS drilled into it
+struct Rotor {
+  WheelMicros edgeMicros;
+  int hole;  // Hole the next interval ends on
+
+  Rotor(WheelMicros startMicros, int firstHole) : edgeMicros(startMicros), hole(firstHole) {}
+
+  WheelMicros next() {
+    float revolutionMicros = 60000000.0 / (TEST_MPH * mphToRpmFactor);
+    edgeMicros += WheelMicros(revolutionMicros / VehicleWheel::TARGETS * (1 + HOLE_ERRORS[hole]));
+    hole = (hole + 1) % VehicleWheel::TARGETS;
+    return edgeMicros;
+  }
+};
+
+// Peak to peak speed over the last two of 'revolutions' revolutions
+float runRevolutions(VehicleWheel &wheel, Rotor &rotor, int revolutions) {
+  float lowest = 1e9;
+  float highest = 0;
+  for (int i = 0; i < revolutions * VehicleWheel::TARGETS; i++) {
+    wheel.processEdge(rotor.next());
+    if (i >= (revolutions - 2) * VehicleWheel::TARGETS) {
+      lowest = std::min(lowest, wheel.wheelSpeedMPH);
+      highest = std::max(highest, wheel.wheelSpeedMPH);
+    }
+  }
+  return highest - lowest;
+}
+
+void testRippleAndRelock() {
+  VehicleWheel wheel(19);
+  wheel.persistToothCalibration = false;
+  wheel.speedEstimator = AVERAGE_INTERVALS;  // Averages fewer teeth than a revolution, so the ripple shows
+  Rotor rotor(wheelMicros() + 1000000, 0);
+
+  char line[80];
+  float unlearned = runRevolutions(wheel, rotor, UNLEARNED_REVOLUTIONS);
+  float learned = runRevolutions(wheel, rotor, LEARNING_REVOLUTIONS);
+  snprintf(line, sizeof(line), "Ripple before learning %.3f MPH, after %.3f MPH:", unlearned, learned);
+  Serial.println(line);
+  check(unlearned > MIN_UNLEARNED_RIPPLE_MPH, "uneven holes show up as ripple");
+  check(learned < MAX_LEARNED_RIPPLE_MPH, "learned table removes the ripple");
+
+  // Stop past the zero timeout, then restart with a different hole first so the numbering is off
+  WheelMicros stoppedMicros = rotor.edgeMicros + ZERO_TIMEOUT_MICROS + 1;
+  wheel.checkZeroRPM(stoppedMicros);
+  Rotor restarted(stoppedMicros + 1000000, 2);
+  wheel.processEdge(restarted.next());
+  check(!wheel.toothPhaseLocked, "phase is unknown after the timeout");
+
+  float relocked = runRevolutions(wheel, restarted, RELOCK_REVOLUTIONS);
+  snprintf(line, sizeof(line), "Ripple after restarting on another hole %.3f MPH:", relocked);
+  Serial.println(line);
+  check(wheel.toothPhaseLocked, "phase locks again");
+  check(relocked < MAX_LEARNED_RIPPLE_MPH, "re-locked table still removes the ripple");
+}
+
+bool toothTableSaved(VehicleWheel &wheel) {
+  char key[16];
+  snprintf(key, sizeof(key), "tooth%d", wheel.sensorPin);
+  Preferences preferences;
+  preferences.begin("wheelcal", true);
+  bool saved = preferences.isKey(key);
+  preferences.end();
+  return saved;
+}
+
+// Turns the wheels that 'turning' selects through one bank update per edge period
+void driveBank(WheelBank &bank, Rotor *rotors, const bool *turning, int revolutions) {
+  for (int i = 0; i < revolutions * VehicleWheel::TARGETS; i++) {
+    WheelMicros edgeMicros = 0;
+    for (int w = 0; w < WHEEL_COUNT; w++) {
+      edgeMicros = rotors[w].next();
+      if (turning[w]) bank.wheel(w).handleEdge(edgeMicros);
+    }
+    mockMicros = edgeMicros;
+    bank.update();
+  }
+}
+
+void testSaveOnlyWhenStopped() {
+  Serial.println("Saving the learned tables:");
+  mockClearPreferences();
+  mockMicros += 1000000;
+  VehicleWheel frontLeft(19), frontRight(17), rearLeft(18), rearRight(16);
+  WheelBank bank(frontLeft, frontRight, rearLeft, rearRight);
+  Rotor rotors[WHEEL_COUNT] = { Rotor(mockMicros, 0), Rotor(mockMicros, 1), Rotor(mockMicros, 2), Rotor(mockMicros, 3) };
+
+  const bool allTurning[WHEEL_COUNT] = { true, true, true, true };
+  driveBank(bank, rotors, allTurning, 150);
+  check(frontLeft.toothCalibrationUnsaved(), "enough learned to be worth saving");
+
+  // Front left locks up and times out while the others keep turning
+  const bool frontLeftLocked[WHEEL_COUNT] = { false, true, true, true };
+  driveBank(bank, rotors, frontLeftLocked, 30);
+  check(frontLeft.diagnostics.timeouts == 1, "locked wheel timed out");
+  check(!toothTableSaved(frontLeft), "nothing saved while three wheels turn");
+
+  const bool allStopped[WHEEL_COUNT] = { false, false, false, false };
+  driveBank(bank, rotors, allStopped, 15);
+  check(toothTableSaved(frontLeft) && toothTableSaved(rearRight), "saved once every wheel reads zero");
+  check(!frontLeft.toothCalibrationUnsaved(), "nothing left to save");
+}
+
+int main() {
+  testRippleAndRelock();
+  testSaveOnlyWhenStopped();
+
+  Serial.println(failures == 0 ? "Tooth calibration tests passed" : "Tooth calibration tests FAILED");
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,138 @@
+// Checks VehicleSpeedEstimator: it follows the second-slowest wheel while driving and the
+// second-fastest while braking, rejects a wheel reference more than REFERENCE_WHEEL_GATE_MPH from
+// the IMU prediction (carrying on with the IMU instead), and only lets GPS in while it does
+
+#include <Arduino.h>
+#include "Wheel.h"
+#include "VehicleSpeed.h"
+
+const WheelMicros STEP_MICROS = 1000;  // One update per millisecond, roughly the wheel task's rate at speed
+const float CRUISE_MPH = 20;
+const float MPH_PER_MPS = 2.23694;
+
+int failures = 0;
+
+void check(bool passed, const char *name) {
+  Serial.print(passed ? "  pass: " : "  FAIL: ");
+  Serial.println(name);
+  if (!passed) failures++;
+}
+
+struct Drive {
+  VehicleSpeedEstimator estimator;
+  WheelMicros now;
+
+  Drive() : now(1000000) {}
+
+  // Runs the estimator for 'seconds' with all four wheels at the given speeds
+  float run(float seconds, const float *wheelSpeedMPH) {
+    int steps = int(seconds * 1000000 / STEP_MICROS);
+    for (int i = 0; i < steps; i++) {
+      now += STEP_MICROS;
+      estimator.update(now, wheelSpeedMPH);
+    }
+    return estimator.speedMPH;
+  }
+
+  float run(float seconds, float allWheelsMPH) {
+    float speeds[4] = { allWheelsMPH, allWheelsMPH, allWheelsMPH, allWheelsMPH };
+    return run(seconds, speeds);
+  }
+
+  // Settles on CRUISE_MPH with no IMU, GPS or brake input
+  void cruise() {
+    estimator.setInputs(0, 0, 0);
+    run(1, CRUISE_MPH);
+  }
+};
+
+void testWheelSelection() {
+  Serial.println("Wheel reference:");
+  const float speeds[4] = { 10, 30, 12, 11 };  // One wheel spinning, one slow
+
+  Drive driving;
+  driving.estimator.setInputs(0, 0, 0);
+  driving.run(0.01, speeds);
+  check(driving.estimator.wheelReferenceMPH == 11, "second-slowest wheel while driving");
+
+  Drive braking;
+  braking.estimator.setInputs(0, 0, REFERENCE_BRAKING_PEDAL_PERCENT + 1);
+  braking.run(0.01, speeds);
+  check(braking.estimator.wheelReferenceMPH == 12, "second-fastest wheel while braking");
+
+  Drive lightBraking;
+  lightBraking.estimator.setInputs(0, 0, REFERENCE_BRAKING_PEDAL_PERCENT);
+  lightBraking.run(0.01, speeds);
+  check(lightBraking.estimator.wheelReferenceMPH == 11, "a brake pedal at the threshold still counts as driving");
+}
+
+void testGate() {
+  Serial.println("IMU gate:");
+  const float stepMPH = 10;
+  const float inside = REFERENCE_WHEEL_GATE_MPH - 1;
+
+  // Inside the gate the reference follows the wheels within a few time constants
+  Drive small;
+  small.cruise();
+  float followed = small.run(0.1, CRUISE_MPH + inside) - CRUISE_MPH;
+  check(!small.estimator.wheelReferenceRejected, "a step inside the gate is accepted");
+  check(followed > 0.8 * inside, "and followed quickly");
+
+  // All four wheels spinning up at once is outside it: the reference barely moves
+  Drive spinning;
+  spinning.cruise();
+  float moved = spinning.run(0.1, CRUISE_MPH + stepMPH) - CRUISE_MPH;
+  check(spinning.estimator.wheelReferenceRejected, "all four wheels spinning is rejected");
+  check(moved < 0.15 * stepMPH, "and the reference holds");
+
+  // All four locked under braking: the IMU carries the estimate down, pulled toward the stopped
+  // wheels only at REFERENCE_SLIP_TIME_CONSTANT instead of REFERENCE_WHEEL_TIME_CONSTANT
+  const float decelerationMPS2 = -8;  // ~0.8 g
+  const float seconds = 0.5;
+  Drive locked;
+  locked.cruise();
+  locked.estimator.setInputs(decelerationMPS2, 0, 100);
+  float lockedMPH = locked.run(seconds, 0.0f);
+  float decay = expf(-seconds / REFERENCE_SLIP_TIME_CONSTANT);
+  float expectedMPH = CRUISE_MPH * decay + decelerationMPS2 * MPH_PER_MPS * REFERENCE_SLIP_TIME_CONSTANT * (1 - decay);
+  char line[80];
+  snprintf(line, sizeof(line), "  locked wheels: %.2f MPH, first-order IMU/slip model %.2f MPH", lockedMPH, expectedMPH);
+  Serial.println(line);
+  check(locked.estimator.wheelReferenceRejected, "four locked wheels are rejected");
+  check(fabsf(lockedMPH - expectedMPH) < 0.2, "the IMU carries the estimate");
+}
+
+void testGps() {
+  Serial.println("GPS fallback:");
+  const int gpsMPS = 9;
+  const float spinningMPH = CRUISE_MPH + 15;
+
+  // While the wheels are accepted, GPS makes no difference at all
+  Drive withGps, withoutGps;
+  withGps.cruise();
+  withoutGps.cruise();
+  withGps.estimator.setInputs(0, gpsMPS, 0);
+  check(withGps.run(0.5, CRUISE_MPH + 1) == withoutGps.run(0.5, CRUISE_MPH + 1), "ignored while the wheel reference is accepted");
+
+  // While they are rejected it pulls the estimate toward the GPS speed
+  Drive slideGps, slideNoFix;
+  slideGps.cruise();
+  slideNoFix.cruise();
+  slideGps.estimator.setInputs(0, gpsMPS, 0);
+  float gpsMPH = slideGps.run(0.5, spinningMPH);
+  float noFixMPH = slideNoFix.run(0.5, spinningMPH);
+  check(slideGps.estimator.wheelReferenceRejected, "wheel reference rejected");
+  check(fabsf(gpsMPH - gpsMPS * MPH_PER_MPS) < fabsf(noFixMPH - gpsMPS * MPH_PER_MPS), "used while the wheel reference is rejected");
+
+  // gpsVelocity reads 0 without a fix (slideNoFix); that must not pull the estimate toward a stop
+  check(noFixMPH > CRUISE_MPH, "a zero GPS speed is treated as no fix");
+}
+
+int main() {
+  testWheelSelection();
+  testGate();
+  testGps();
+
+  Serial.println(failures == 0 ? "Vehicle speed tests passed" : "Vehicle speed tests FAILED");
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,109 @@
+// Checks WheelCaptureInput's missed-capture detection: PCNT trailing the captures by an edge (its
+// glitch filter delays the count) must never resync the wheel, while an edge PCNT counted that
+// never produced a capture must, exactly once
+
+#include <Arduino.h>
+#include "Wheel.h"
+#include "VehicleSpeed.h"
+#include "WheelBank.h"
+#include "WheelTask.h"
+#include "WheelCapture.h"
+
+const float TEST_MPH = 25;
+const int TEST_EDGES = 500;
+const WheelMicros FILTER_DELAY_MICROS = 13;  // PCNT_FILTER_TICKS at 80 MHz, rounded up
+
+int failures = 0;
+
+void check(bool condition, const char *what) {
+  Serial.print(condition ? "  pass: " : "  FAIL: ");
+  Serial.println(what);
+  if (!condition) failures++;
+}
+
+struct CaptureRig {
+  VehicleWheel frontLeft, frontRight, rearLeft, rearRight;
+  WheelCaptureInput capture;
+  int16_t pcntCount;
+  WheelMicros edgeMicros;  // When the last front left edge arrived; polls in between don't move it
+
+  // Starts a second after whatever the clock says, so the wheels never see an edge older than their construction
+  CaptureRig() : frontLeft(19), frontRight(17), rearLeft(18), rearRight(16), pcntCount(0), edgeMicros(mockMicros + 1000000) {
+    frontLeft.persistToothCalibration = false;
+    mockMicros = edgeMicros;
+    capture.begin(frontLeft, frontRight, rearLeft, rearRight);
+  }
+
+  // One front left edge toothMicros after the last: the capture ISR fires right away, PCNT only
+  // counts it FILTER_DELAY_MICROS later
+  void edge(WheelMicros toothMicros, bool pcntTrailsPoll) {
+    edgeMicros += toothMicros;
+    mockMicros = edgeMicros;
+    mockCapture(MCPWM_UNIT_0, MCPWM_SELECT_CAP0, uint32_t(mockMicros * CAPTURE_TICKS_PER_MICRO));  // Capture timer runs from boot
+
+    if (!pcntTrailsPoll) mockSetPcntCount(PCNT_UNIT_0, ++pcntCount);
+    pollAndUpdate();
+    if (pcntTrailsPoll) {
+      mockMicros += FILTER_DELAY_MICROS;
+      mockSetPcntCount(PCNT_UNIT_0, ++pcntCount);
+    }
+  }
+
+  void pollAndUpdate() {
+    capture.poll();
+    frontLeft.calculateRPM();
+    frontLeft.checkZeroRPM(mockMicros);
+  }
+};
+
+WheelMicros toothMicrosAt(float mph) {
+  return WheelMicros(60000000.0 / (mph * mphToRpmFactor) / VehicleWheel::TARGETS);
+}
+
+// The task is woken by the capture ISR before PCNT has counted the edge, so every poll at an
+// edge sees a deficit of -1; the timeout poll in between sees PCNT caught up
+void testTrailingCount() {
+  Serial.println("PCNT trailing the captures by one edge:");
+  CaptureRig rig;
+  for (int i = 0; i < TEST_EDGES; i++) {
+    rig.edge(toothMicrosAt(TEST_MPH), true);
+    if (i % 2 == 0) {
+      mockMicros += 1000;
+      rig.pollAndUpdate();
+    }
+  }
+  check(rig.capture.missedCaptures(0) == 0, "no missed captures reported");
+  check(rig.frontLeft.diagnostics.baselineResets == 0, "wheel never resynced");
+  check(fabsf(rig.frontLeft.predictSpeedMPH(mockMicros) - TEST_MPH) < 0.05, "speed tracks through every edge");
+}
+
+// PCNT counts an edge the capture unit never reported (e.g. the queue was full)
+void testMissedCapture() {
+  Serial.println("Edge counted by PCNT but never captured:");
+  CaptureRig rig;
+  for (int i = 0; i < TEST_EDGES / 2; i++) {
+    rig.edge(toothMicrosAt(TEST_MPH), i % 3 == 0);
+  }
+  unsigned long resetsBefore = rig.frontLeft.diagnostics.baselineResets;
+
+  WheelMicros toothMicros = toothMicrosAt(TEST_MPH);
+  rig.edgeMicros += toothMicros;
+  mockMicros = rig.edgeMicros;
+  mockSetPcntCount(PCNT_UNIT_0, ++rig.pcntCount);
+  rig.pollAndUpdate();
+
+  for (int i = 0; i < TEST_EDGES / 2; i++) {
+    rig.edge(toothMicros, i % 3 == 0);
+  }
+  check(rig.capture.missedCaptures(0) == 1, "one missed capture reported");
+  check(rig.frontLeft.diagnostics.baselineResets == resetsBefore + 1, "wheel resynced once");
+  check(fabsf(rig.frontLeft.predictSpeedMPH(mockMicros) - TEST_MPH) < 0.05, "speed recovers after the resync");
+}
+
+int main() {
+  testTrailingCount();
+  testMissedCapture();
+
+  Serial.println(failures == 0 ? "Wheel capture tests passed" : "Wheel capture tests FAILED");
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,118 @@
+// Checks the integer centi-MPH pipeline (speed, and acceleration from its fixed-point tracker) against
+// the float one on the same pulse trains, then times both per edge (the same benchmark
+// RUN_WHEEL_BENCHMARK runs on the car). Also times WheelBank::update() against the same work done
+// one wheel at a time; that needs the virtual clock, so it only runs here
+
+#include <Arduino.h>
+#include "Wheel.h"
+#include "VehicleSpeed.h"
+#include "WheelBank.h"
+#include "ShockFilter.h"
+#include "WheelBenchmark.h"
+
+const float PIPELINE_TOLERANCE_MPH = 0.02;  // Centi-MPH rounding plus the folded constant's rounding
+const float ACCELERATION_TOLERANCE_MPHPS = 0.1;  // Fixed-point tracker against the float one
+
+const SpeedEstimator estimators[] = { AVERAGE_INTERVALS, MULTI_TOOTH, ALPHA_BETA };
+const char *estimatorNames[] = { "AVERAGE_INTERVALS", "MULTI_TOOTH", "ALPHA_BETA" };
+
+// Largest float/integer speed disagreement over a jittered pulse train accelerating from startMPH to
+// endMPH; the largest tracked acceleration disagreement goes in worstAcceleration
+float pipelineDifferenceMPH(SpeedEstimator estimator, float startMPH, float endMPH, float &worstAcceleration) {
+  VehicleWheel floatWheel(19);
+  VehicleWheel integerWheel(19);
+  floatWheel.speedEstimator = estimator;
+  integerWheel.speedEstimator = estimator;
+  floatWheel.integerPipeline = false;
+  integerWheel.integerPipeline = true;
+  floatWheel.persistToothCalibration = false;
+  integerWheel.persistToothCalibration = false;
+
+  const int edges = 400;
+  WheelMicros edgeMicros = 1000000;
+  uint32_t noise = 12345;
+  float worst = 0;
+  worstAcceleration = 0;
+  for (int i = 0; i < edges; i++) {
+    float mph = startMPH + (endMPH - startMPH) * i / edges;
+    noise = noise * 1664525 + 1013904223;  // LCG, +/-16us of jitter
+    edgeMicros += WheelMicros(60000000.0 / (mph * mphToRpmFactor) / VehicleWheel::TARGETS) + (noise >> 27) - 16;
+
+    floatWheel.processEdge(edgeMicros);
+    integerWheel.processEdge(edgeMicros);
+    float difference = fabsf(floatWheel.wheelSpeedMPH - integerWheel.wheelSpeedMPH);
+    if (difference > worst) worst = difference;
+    float accelerationDifference = fabsf(floatWheel.wheelAccelerationMPHps - integerWheel.wheelAccelerationMPHps);
+    if (accelerationDifference > worstAcceleration) worstAcceleration = accelerationDifference;
+  }
+  return worst;
+}
+
+const int BANK_BENCHMARK_UPDATES = 20000;
+
+// Average cycles per update with one edge per wheel in between. With 'banked' false each wheel is
+// drained, timestamped and extrapolated on its own, the way loop() did it before WheelBank, and
+// there is no snapshot to publish
+uint32_t benchmarkBankUpdate(bool banked) {
+  VehicleWheel frontLeft(19), frontRight(17), rearLeft(18), rearRight(16);
+  WheelBank bank(frontLeft, frontRight, rearLeft, rearRight);
+  for (int i = 0; i < WHEEL_COUNT; i++) bank.wheel(i).persistToothCalibration = false;
+
+  WheelMicros toothMicros = WheelMicros(60000000.0 / (BENCHMARK_SPEED_MPH * mphToRpmFactor) / VehicleWheel::TARGETS);
+  WheelMicros edgeMicros = mockMicros + 1000000;
+  float speedMPH[WHEEL_COUNT];
+
+  uint32_t start = ESP.getCycleCount();
+  for (int u = 0; u < BANK_BENCHMARK_UPDATES; u++) {
+    edgeMicros += toothMicros;
+    for (int i = 0; i < WHEEL_COUNT; i++) bank.wheel(i).handleEdge(edgeMicros + i);
+    mockMicros = edgeMicros + toothMicros / 2;
+
+    if (banked) {
+      bank.update();
+    } else {
+      for (int i = 0; i < WHEEL_COUNT; i++) {
+        VehicleWheel &w = bank.wheel(i);
+        w.calculateRPM();
+        WheelMicros now = wheelMicros();
+        w.checkZeroRPM(now);
+        speedMPH[i] = w.predictSpeedMPH(now) * w.tireScale;
+      }
+      WheelMicros now = wheelMicros();
+      bank.vehicleSpeed().update(now, speedMPH);
+      for (int i = 0; i < WHEEL_COUNT; i++) bank.wheel(i).checkWheelState(now, speedMPH[i]);
+    }
+  }
+  uint32_t totalCycles = ESP.getCycleCount() - start;
+
+  if (bank.snapshot().speedMPH[0] == 0 && frontLeft.wheelSpeedMPH == 0) Serial.println("Bank benchmark produced no speed");
+  return totalCycles / BANK_BENCHMARK_UPDATES;
+}
+
+int main() {
+  const float ranges[][2] = { { 3, 3 }, { 20, 20 }, { 44, 44 }, { 3, 44 }, { 44, 5 } };
+  const int rangeCount = sizeof(ranges) / sizeof(ranges[0]);
+
+  bool passed = true;
+  Serial.println("Integer vs float pipeline, largest difference:");
+  for (int e = 0; e < 3; e++) {
+    for (int r = 0; r < rangeCount; r++) {
+      float acceleration;
+      float difference = pipelineDifferenceMPH(estimators[e], ranges[r][0], ranges[r][1], acceleration);
+      bool rangePassed = difference <= PIPELINE_TOLERANCE_MPH && acceleration <= ACCELERATION_TOLERANCE_MPHPS;
+      char line[100];
+      snprintf(line, sizeof(line), "  %-17s %2.0f-%2.0f MPH  %.4f MPH  %.4f MPH/s%s", estimatorNames[e], ranges[r][0], ranges[r][1],
+               difference, acceleration, rangePassed ? "" : "  FAIL");
+      Serial.println(line);
+      passed = passed && rangePassed;
+    }
+  }
+
+  // Host timings are only comparable with each other, not with the ESP32's
+  runWheelBenchmark(19);
+  Serial.println("Four wheels, one edge each per update:");
+  printWheelBenchmark("  one wheel at a time", benchmarkBankUpdate(false));
+  printWheelBenchmark("  WheelBank::update()", benchmarkBankUpdate(true));
+
+  return passed ? 0 : 1;
+}
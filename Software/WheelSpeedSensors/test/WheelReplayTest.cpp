@@ -0,0 +1,12 @@
+// Replays every WheelReplay.h scenario through each estimator and fails on any error or latency limit
+
+#include <Arduino.h>
+#include "Wheel.h"
+#include "VehicleSpeed.h"
+#include "WheelBank.h"
+#include "WheelTask.h"
+#include "WheelReplay.h"
+
+int main() {
+  return runWheelReplay(19) ? 0 : 1;
+}
@@ -0,0 +1,113 @@
+// Checks Wheel::checkWheelState(): spin and skid are entered past the enter slip and only left
+// past the tighter exit slip, a new state has to hold for WHEEL_STATE_ENTER_MICROS before it is
+// reported, and a reported state is kept for at least WHEEL_STATE_MIN_DWELL_MICROS
+
+#include <Arduino.h>
+#include "Wheel.h"
+
+const WheelMicros STEP_MICROS = 1000;
+const float REFERENCE_MPH = 20;
+
+// Wheel speeds giving each slip ratio against REFERENCE_MPH
+const float SPIN_MPH = REFERENCE_MPH * (1 + wheelSpinEnterSlip + 0.05);
+const float BETWEEN_SPIN_MPH = REFERENCE_MPH * (1 + (wheelSpinEnterSlip + wheelSpinExitSlip) / 2);
+const float SKID_MPH = REFERENCE_MPH * (1 + wheelSkidEnterSlip - 0.05);
+const float BETWEEN_SKID_MPH = REFERENCE_MPH * (1 + (wheelSkidEnterSlip + wheelSkidExitSlip) / 2);
+
+int failures = 0;
+
+void check(bool passed, const char *name) {
+  Serial.print(passed ? "  pass: " : "  FAIL: ");
+  Serial.println(name);
+  if (!passed) failures++;
+}
+
+// A wheel judged once per STEP_MICROS against REFERENCE_MPH, starting well past its construction dwell
+struct StateRig {
+  VehicleWheel wheel;
+  WheelMicros now;
+
+  StateRig() : wheel(19), now(mockMicros + 1000000) {
+    wheel.persistToothCalibration = false;
+    vehicleSpeedMPH = REFERENCE_MPH;
+  }
+
+  // Holds speedMPH for 'micros' and returns how long after the start the state changed, or -1
+  WheelMicros hold(float speedMPH, WheelMicros micros) {
+    WheelState before = wheel.wheelState;
+    WheelMicros start = now;
+    WheelMicros changed = -1;
+    for (WheelMicros t = 0; t < micros; t += STEP_MICROS) {
+      wheel.checkWheelState(now, speedMPH);
+      if (changed < 0 && wheel.wheelState != before) changed = now - start;
+      now += STEP_MICROS;
+    }
+    return changed;
+  }
+};
+
+void testEnterConfirm() {
+  Serial.println("Enter confirm:");
+  StateRig rig;
+  check(rig.hold(SPIN_MPH, 100000) == WheelMicros(WHEEL_STATE_ENTER_MICROS), "spin reported after WHEEL_STATE_ENTER_MICROS");
+  check(rig.wheel.wheelState == SPIN, "wheel is spinning");
+
+  StateRig blip;
+  blip.hold(SPIN_MPH, WHEEL_STATE_ENTER_MICROS - STEP_MICROS);
+  blip.hold(REFERENCE_MPH, 500000);
+  check(blip.wheel.wheelState == GOOD, "a spin shorter than the confirm is never reported");
+
+  StateRig skid;
+  check(skid.hold(SKID_MPH, 100000) == WheelMicros(WHEEL_STATE_ENTER_MICROS), "skid reported after WHEEL_STATE_ENTER_MICROS");
+  check(skid.wheel.wheelState == SKID, "wheel is skidding");
+}
+
+void testHysteresis() {
+  Serial.println("Hysteresis:");
+  StateRig good;
+  good.hold(BETWEEN_SPIN_MPH, 1000000);
+  check(good.wheel.wheelState == GOOD, "slip between exit and enter doesn't start a spin");
+  good.hold(BETWEEN_SKID_MPH, 1000000);
+  check(good.wheel.wheelState == GOOD, "or a skid");
+
+  StateRig spin;
+  spin.hold(SPIN_MPH, 100000);
+  spin.hold(BETWEEN_SPIN_MPH, 1000000);
+  check(spin.wheel.wheelState == SPIN, "slip between exit and enter keeps a spin");
+  spin.hold(REFERENCE_MPH * (1 + wheelSpinExitSlip - 0.02), 300000);
+  check(spin.wheel.wheelState == GOOD, "below the exit slip ends it");
+
+  StateRig skid;
+  skid.hold(SKID_MPH, 100000);
+  skid.hold(BETWEEN_SKID_MPH, 1000000);
+  check(skid.wheel.wheelState == SKID, "slip between exit and enter keeps a skid");
+  skid.hold(REFERENCE_MPH * (1 + wheelSkidExitSlip + 0.02), 300000);
+  check(skid.wheel.wheelState == GOOD, "above the exit slip ends it");
+}
+
+void testDwell() {
+  Serial.println("Dwell:");
+  StateRig rig;
+  rig.hold(SPIN_MPH, WHEEL_STATE_ENTER_MICROS + STEP_MICROS);
+  check(rig.wheel.wheelState == SPIN, "spinning");
+
+  // The spin has been reported for one step; GOOD is confirmed after 30 ms but has to wait out the dwell
+  WheelMicros left = rig.hold(REFERENCE_MPH, 500000);
+  check(left == WheelMicros(WHEEL_STATE_MIN_DWELL_MICROS) - STEP_MICROS, "held for WHEEL_STATE_MIN_DWELL_MICROS");
+  check(rig.wheel.wheelState == GOOD, "then back to GOOD");
+
+  // Straight from a spin into a skid obeys the same dwell
+  StateRig reverse;
+  reverse.hold(SPIN_MPH, WHEEL_STATE_ENTER_MICROS + STEP_MICROS);
+  check(reverse.hold(SKID_MPH, 500000) == WheelMicros(WHEEL_STATE_MIN_DWELL_MICROS) - STEP_MICROS, "spin to skid waits out the dwell too");
+  check(reverse.wheel.wheelState == SKID, "then skids");
+}
+
+int main() {
+  testEnterConfirm();
+  testHysteresis();
+  testDwell();
+
+  Serial.println(failures == 0 ? "Wheel state tests passed" : "Wheel state tests FAILED");
+  return failures == 0 ? 0 : 1;
+}
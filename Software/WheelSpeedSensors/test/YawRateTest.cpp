@@ -0,0 +1,92 @@
+// Checks YawRateEstimator on wheel speeds built from a known turn: the estimate is in deg/s,
+// positive to the left, averaged over the axles whose wheels are both GOOD, and NAN (with the gyro
+// discrepancy) when neither axle is usable
+
+#include <Arduino.h>
+#include "Wheel.h"
+#include "VehicleSpeed.h"
+#include "WheelBank.h"
+#include "YawRate.h"
+
+const float CAR_MPH = 15;
+const float TURN_DPS = 20;
+const float INCHES_PER_SECOND_PER_MPH = 17.6;  // 5280 * 12 / 3600, kept independent of Wheel.h
+const float TOLERANCE_DPS = 0.01;
+
+int failures = 0;
+
+void check(bool passed, const char *name) {
+  Serial.print(passed ? "  pass: " : "  FAIL: ");
+  Serial.println(name);
+  if (!passed) failures++;
+}
+
+// Wheel speeds of a car at CAR_MPH yawing at yawDPS (positive left), every wheel GOOD
+WheelSnapshot turning(float yawDPS) {
+  WheelSnapshot wheels;
+  memset(&wheels, 0, sizeof(wheels));
+  float yawRadians = yawDPS * float(M_PI) / 180;
+  float frontOffsetMPH = yawRadians * FRONT_TRACK_WIDTH_INCHES / 2 / INCHES_PER_SECOND_PER_MPH;
+  float rearOffsetMPH = yawRadians * REAR_TRACK_WIDTH_INCHES / 2 / INCHES_PER_SECOND_PER_MPH;
+  wheels.speedMPH[FRONT_LEFT] = CAR_MPH - frontOffsetMPH;
+  wheels.speedMPH[FRONT_RIGHT] = CAR_MPH + frontOffsetMPH;
+  wheels.speedMPH[REAR_LEFT] = CAR_MPH - rearOffsetMPH;
+  wheels.speedMPH[REAR_RIGHT] = CAR_MPH + rearOffsetMPH;
+  for (int i = 0; i < WHEEL_COUNT; i++) wheels.state[i] = GOOD;
+  return wheels;
+}
+
+void testUnitsAndSign() {
+  Serial.println("Units and sign:");
+  YawRateEstimator yaw;
+  yaw.update(turning(TURN_DPS));
+  check(fabsf(yaw.wheelYawDPS - TURN_DPS) < TOLERANCE_DPS, "a 20 deg/s left turn reads +20 deg/s");
+  yaw.update(turning(-TURN_DPS));
+  check(fabsf(yaw.wheelYawDPS + TURN_DPS) < TOLERANCE_DPS, "a right turn reads negative");
+  yaw.update(turning(0));
+  check(yaw.wheelYawDPS == 0, "straight reads zero");
+
+  yaw.setGyro(TURN_DPS + 5);
+  yaw.update(turning(TURN_DPS));
+  check(fabsf(yaw.discrepancyDPS - (GYRO_YAW_SIGN * (TURN_DPS + 5) - TURN_DPS)) < TOLERANCE_DPS, "discrepancy is gyro minus wheels");
+}
+
+void testAxleSelection() {
+  Serial.println("Axle selection:");
+  YawRateEstimator yaw;
+
+  // Each axle disagrees with the other, so which ones were used shows in the result
+  WheelSnapshot wheels = turning(TURN_DPS);
+  wheels.speedMPH[REAR_RIGHT] += 0.5;
+  float rearOnlyDPS = (wheels.speedMPH[REAR_RIGHT] - wheels.speedMPH[REAR_LEFT]) * INCHES_PER_SECOND_PER_MPH
+                      / REAR_TRACK_WIDTH_INCHES * 180 / float(M_PI);
+
+  yaw.update(wheels);
+  check(fabsf(yaw.wheelYawDPS - (TURN_DPS + rearOnlyDPS) / 2) < TOLERANCE_DPS, "both axles GOOD are averaged");
+
+  wheels.state[REAR_RIGHT] = SPIN;
+  yaw.update(wheels);
+  check(fabsf(yaw.wheelYawDPS - TURN_DPS) < TOLERANCE_DPS, "a spinning rear wheel leaves the front axle");
+
+  wheels.state[REAR_RIGHT] = GOOD;
+  wheels.state[FRONT_LEFT] = SKID;
+  yaw.update(wheels);
+  check(fabsf(yaw.wheelYawDPS - rearOnlyDPS) < TOLERANCE_DPS, "a skidding front wheel leaves the rear axle");
+
+  yaw.setGyro(TURN_DPS);
+  wheels.state[REAR_LEFT] = SPIN;
+  yaw.update(wheels);
+  check(isnan(yaw.wheelYawDPS) && isnan(yaw.discrepancyDPS), "NAN with neither axle usable");
+
+  wheels.state[FRONT_LEFT] = GOOD;
+  yaw.update(wheels);
+  check(fabsf(yaw.wheelYawDPS - TURN_DPS) < TOLERANCE_DPS, "and back as soon as one is");
+}
+
+int main() {
+  testUnitsAndSign();
+  testAxleSelection();
+
+  Serial.println(failures == 0 ? "Yaw rate tests passed" : "Yaw rate tests FAILED");
+  return failures == 0 ? 0 : 1;
+}
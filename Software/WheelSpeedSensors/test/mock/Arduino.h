@@ -0,0 +1,119 @@
+/*
+
+  Host stand-in for the parts of the Arduino-ESP32 core the wheel and shock headers use.
+
+  Time comes from one virtual clock (mockMicros, see esp_timer.h) that tests set directly,
+  so micros(), millis() and wheelMicros() all agree and nothing depends on the host's
+  scheduling. Interrupts don't exist on the host, so noInterrupts()/interrupts() do nothing.
+  Serial prints to stdout; ESP.getCycleCount() counts host nanoseconds scaled to the ESP32's
+  240 MHz so benchmark output reads in the same units as on the car.
+
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <type_traits>
+#include <algorithm>
+
+#include "freertos/FreeRTOS.h"
+#include "esp_timer.h"
+
+#define IRAM_ATTR
+
+#define INPUT 0x01
+#define INPUT_PULLUP 0x05
+#define LOW 0x0
+#define HIGH 0x1
+#define RISING 0x01
+
+#define DEC 10
+#define HEX 16
+
+typedef uint8_t byte;
+
+unsigned long micros();
+unsigned long millis();
+void delay(unsigned long ms);
+void noInterrupts();
+void interrupts();
+
+void pinMode(int pin, int mode);
+int digitalRead(int pin);
+int analogRead(int pin);
+void mockSetAnalogRead(int value);  // What every analogRead() returns from now on
+
+int digitalPinToInterrupt(int pin);
+void attachInterrupt(int interrupt, void (*handler)(), int mode);
+
+class HardwareSerial {
+
+private:
+
+  static size_t printValue(const char *value, int) {
+    return fputs(value, stdout) >= 0 ? strlen(value) : 0;
+  }
+
+  static size_t printValue(char value, int) {
+    return fputc(value, stdout) != EOF ? 1 : 0;
+  }
+
+  template <typename T>
+  static typename std::enable_if<std::is_integral<T>::value, size_t>::type printValue(T value, int base) {
+    if (base == HEX) return printf("%llX", (unsigned long long)value);
+    if (std::is_signed<T>::value) return printf("%lld", (long long)value);
+    return printf("%llu", (unsigned long long)value);
+  }
+
+  template <typename T>
+  static typename std::enable_if<std::is_floating_point<T>::value, size_t>::type printValue(T value, int digits) {
+    return printf("%.*f", digits, (double)value);
+  }
+
+public:
+
+  void begin(unsigned long) {}
+  int available() { return 0; }
+  int read() { return -1; }
+
+  // Same defaults as Print: base 10 for integers, 2 digits for floats
+  template <typename T>
+  size_t print(T value) {
+    return printValue(value, std::is_floating_point<T>::value ? 2 : DEC);
+  }
+
+  template <typename T>
+  size_t print(T value, int format) {
+    return printValue(value, format);
+  }
+
+  template <typename T>
+  size_t println(T value) {
+    return print(value) + println();
+  }
+
+  template <typename T>
+  size_t println(T value, int format) {
+    return print(value, format) + println();
+  }
+
+  size_t println() {
+    return printValue('\n', 0);
+  }
+};
+
+extern HardwareSerial Serial;
+
+class EspClass {
+
+public:
+
+  uint32_t getCycleCount();
+  uint32_t getCpuFreqMHz() { return 240; }
+};
+
+extern EspClass ESP;
@@ -0,0 +1,204 @@
+// Definitions behind the host stand-ins in this directory
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include "driver/mcpwm.h"
+#include "driver/pcnt.h"
+#include "esp_adc_cal.h"
+
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+
+int64_t mockMicros = 0;
+static int mockAnalogValue = 0;
+
+HardwareSerial Serial;
+EspClass ESP;
+
+int64_t esp_timer_get_time() {
+  return mockMicros;
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *, esp_timer_handle_t *handle) {
+  *handle = NULL;
+  return ESP_OK;
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t, uint64_t) {
+  return ESP_OK;
+}
+
+unsigned long micros() {
+  return (unsigned long)(uint32_t)mockMicros;  // 32 bits like the ESP32, so it wraps the same way
+}
+
+unsigned long millis() {
+  return (unsigned long)(uint32_t)(mockMicros / 1000);
+}
+
+void delay(unsigned long ms) {
+  mockMicros += int64_t(ms) * 1000;
+}
+
+void noInterrupts() {}
+void interrupts() {}
+
+void pinMode(int, int) {}
+
+int digitalRead(int) {
+  return LOW;
+}
+
+int analogRead(int) {
+  return mockAnalogValue;
+}
+
+void mockSetAnalogRead(int value) {
+  mockAnalogValue = value;
+}
+
+int digitalPinToInterrupt(int pin) {
+  return pin;
+}
+
+void attachInterrupt(int, void (*)(), int) {}
+
+uint32_t EspClass::getCycleCount() {
+  using namespace std::chrono;
+  int64_t nanoseconds = duration_cast<std::chrono::nanoseconds>(steady_clock::now().time_since_epoch()).count();
+  return uint32_t(nanoseconds * getCpuFreqMHz() / 1000);
+}
+
+BaseType_t xTaskCreatePinnedToCore(void (*)(void *), const char *, uint32_t, void *, UBaseType_t, TaskHandle_t *handle, BaseType_t) {
+  *handle = NULL;
+  return pdPASS;
+}
+
+BaseType_t xTaskNotifyFromISR(TaskHandle_t, uint32_t, eNotifyAction, BaseType_t *woken) {
+  if (woken != NULL) *woken = pdFALSE;
+  return pdPASS;
+}
+
+BaseType_t xTaskNotifyWait(uint32_t, uint32_t, uint32_t *value, TickType_t) {
+  if (value != NULL) *value = 0;
+  return pdFALSE;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t) {
+  return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t, TickType_t) {
+  return 0;
+}
+
+BaseType_t xPortGetCoreID() {
+  return 0;
+}
+
+void vTaskDelay(TickType_t) {}
+
+esp_err_t mcpwm_gpio_init(mcpwm_unit_t, mcpwm_io_signals_t, int) {
+  return ESP_OK;
+}
+
+static mcpwm_capture_config_t captureConfigs[2][3];
+
+esp_err_t mcpwm_capture_enable_channel(mcpwm_unit_t unit, mcpwm_capture_channel_id_t channel, const mcpwm_capture_config_t *config) {
+  captureConfigs[unit][channel] = *config;
+  return ESP_OK;
+}
+
+bool mockCapture(mcpwm_unit_t unit, mcpwm_capture_channel_id_t channel, uint32_t captureTicks) {
+  const mcpwm_capture_config_t &config = captureConfigs[unit][channel];
+  if (config.capture_cb == NULL) return false;
+  cap_event_data_t data;
+  data.cap_value = captureTicks;
+  data.cap_edge = MCPWM_POS_EDGE;
+  return config.capture_cb(unit, channel, &data, config.user_data);
+}
+
+static int16_t pcntCounts[4];
+
+esp_err_t pcnt_unit_config(const pcnt_config_t *) { return ESP_OK; }
+esp_err_t pcnt_set_filter_value(pcnt_unit_t, uint16_t) { return ESP_OK; }
+esp_err_t pcnt_filter_enable(pcnt_unit_t) { return ESP_OK; }
+esp_err_t pcnt_counter_pause(pcnt_unit_t) { return ESP_OK; }
+esp_err_t pcnt_counter_clear(pcnt_unit_t unit) { pcntCounts[unit] = 0; return ESP_OK; }
+esp_err_t pcnt_counter_resume(pcnt_unit_t) { return ESP_OK; }
+
+void mockSetPcntCount(pcnt_unit_t unit, int16_t count) {
+  pcntCounts[unit] = count;
+}
+
+esp_err_t pcnt_get_counter_value(pcnt_unit_t unit, int16_t *count) {
+  *count = pcntCounts[unit];
+  return ESP_OK;
+}
+
+esp_adc_cal_value_t esp_adc_cal_characterize(adc_unit_t unit, adc_atten_t atten, adc_bits_width_t width, uint32_t defaultVref, esp_adc_cal_characteristics_t *characteristics) {
+  characteristics->adc_num = unit;
+  characteristics->atten = atten;
+  characteristics->bit_width = width;
+  characteristics->coeff_a = 0;
+  characteristics->coeff_b = 0;
+  characteristics->vref = defaultVref;
+  return ESP_ADC_CAL_VAL_DEFAULT_VREF;
+}
+
+uint32_t esp_adc_cal_raw_to_voltage(uint32_t reading, const esp_adc_cal_characteristics_t *) {
+  float x = reading / 4095.0f;
+  float bend = 2 * x - 1;
+  return uint32_t(142 + 2950 * x + 100 * bend * bend * bend);
+}
+
+static std::map<std::string, std::vector<uint8_t> > preferencesStore;
+
+void mockClearPreferences() {
+  preferencesStore.clear();
+}
+
+bool Preferences::begin(const char *, bool, const char *) {
+  return true;
+}
+
+void Preferences::end() {}
+
+bool Preferences::isKey(const char *key) {
+  return preferencesStore.count(key) > 0;
+}
+
+size_t Preferences::getBytesLength(const char *key) {
+  return isKey(key) ? preferencesStore[key].size() : 0;
+}
+
+size_t Preferences::getBytes(const char *key, void *buffer, size_t length) {
+  if (!isKey(key) || preferencesStore[key].size() > length) return 0;
+  memcpy(buffer, preferencesStore[key].data(), preferencesStore[key].size());
+  return preferencesStore[key].size();
+}
+
+size_t Preferences::putBytes(const char *key, const void *value, size_t length) {
+  preferencesStore[key].assign((const uint8_t *)value, (const uint8_t *)value + length);
+  return length;
+}
+
+float Preferences::getFloat(const char *key, float defaultValue) {
+  float value;
+  return getBytes(key, &value, sizeof(value)) == sizeof(value) ? value : defaultValue;
+}
+
+size_t Preferences::putFloat(const char *key, float value) {
+  return putBytes(key, &value, sizeof(value));
+}
+
+int32_t Preferences::getInt(const char *key, int32_t defaultValue) {
+  int32_t value;
+  return getBytes(key, &value, sizeof(value)) == sizeof(value) ? value : defaultValue;
+}
+
+size_t Preferences::putInt(const char *key, int32_t value) {
+  return putBytes(key, &value, sizeof(value));
+}
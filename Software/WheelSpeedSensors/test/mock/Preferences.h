@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// NVS stand-in: one in-memory store shared by every namespace, cleared with mockClearPreferences()
+class Preferences {
+
+public:
+
+  bool begin(const char *name, bool readOnly = false, const char *partition = NULL);
+  void end();
+
+  bool isKey(const char *key);
+  size_t getBytesLength(const char *key);
+  size_t getBytes(const char *key, void *buffer, size_t length);
+  size_t putBytes(const char *key, const void *value, size_t length);
+
+  float getFloat(const char *key, float defaultValue = 0);
+  size_t putFloat(const char *key, float value);
+  int32_t getInt(const char *key, int32_t defaultValue = 0);
+  size_t putInt(const char *key, int32_t value);
+};
+
+void mockClearPreferences();
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "esp_err.h"
+
+typedef enum {
+  MCPWM_UNIT_0,
+  MCPWM_UNIT_1
+} mcpwm_unit_t;
+
+typedef enum {
+  MCPWM_CAP_0 = 12,
+  MCPWM_CAP_1,
+  MCPWM_CAP_2
+} mcpwm_io_signals_t;
+
+typedef enum {
+  MCPWM_SELECT_CAP0,
+  MCPWM_SELECT_CAP1,
+  MCPWM_SELECT_CAP2
+} mcpwm_capture_channel_id_t;
+
+typedef enum {
+  MCPWM_NEG_EDGE = 1,
+  MCPWM_POS_EDGE = 2,
+  MCPWM_BOTH_EDGE = 3
+} mcpwm_capture_on_edge_t;
+
+typedef struct {
+  uint32_t cap_value;
+  mcpwm_capture_on_edge_t cap_edge;
+} cap_event_data_t;
+
+typedef bool (*cap_isr_cb_t)(mcpwm_unit_t unit, mcpwm_capture_channel_id_t channel, const cap_event_data_t *data, void *userData);
+
+typedef struct {
+  mcpwm_capture_on_edge_t cap_edge;
+  uint32_t cap_prescale;
+  cap_isr_cb_t capture_cb;
+  void *user_data;
+} mcpwm_capture_config_t;
+
+esp_err_t mcpwm_gpio_init(mcpwm_unit_t unit, mcpwm_io_signals_t signal, int gpio);
+esp_err_t mcpwm_capture_enable_channel(mcpwm_unit_t unit, mcpwm_capture_channel_id_t channel, const mcpwm_capture_config_t *config);
+
+// Runs the callback registered on a capture channel as if the hardware had latched captureTicks;
+// returns what the callback returned (false if none is registered)
+bool mockCapture(mcpwm_unit_t unit, mcpwm_capture_channel_id_t channel, uint32_t captureTicks);
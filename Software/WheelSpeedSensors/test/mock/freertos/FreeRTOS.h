@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdint.h>
+
+// Enough of FreeRTOS to compile the task code; the tests drive the wheel and shock code directly
+typedef void *TaskHandle_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdFALSE 0
+#define pdTRUE 1
+#define pdPASS 1
+#define portMAX_DELAY 0xFFFFFFFF
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+#define portYIELD_FROM_ISR() do {} while (0)
+
+typedef enum {
+  eNoAction,
+  eSetBits,
+  eIncrement,
+  eSetValueWithOverwrite
+} eNotifyAction;
+
+BaseType_t xTaskCreatePinnedToCore(void (*code)(void *), const char *name, uint32_t stackDepth, void *parameters,
+                                   UBaseType_t priority, TaskHandle_t *handle, BaseType_t core);
+BaseType_t xTaskNotifyFromISR(TaskHandle_t task, uint32_t value, eNotifyAction action, BaseType_t *woken);
+BaseType_t xTaskNotifyWait(uint32_t clearOnEntry, uint32_t clearOnExit, uint32_t *value, TickType_t ticksToWait);
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticksToWait);
+BaseType_t xPortGetCoreID();
+void vTaskDelay(TickType_t ticks);